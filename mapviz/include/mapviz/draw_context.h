@@ -0,0 +1,215 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_DRAW_CONTEXT_H_
+#define MAPVIZ_DRAW_CONTEXT_H_
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// ROS libraries
+#include <tf/transform_datatypes.h>
+
+namespace mapviz
+{
+  /**
+   * An axis-aligned box in the canvas's fixed frame.  A default constructed
+   * box is empty and grows as points are added to it.
+   */
+  class BoundingBox
+  {
+  public:
+    BoundingBox() :
+      min_x_(std::numeric_limits<double>::max()),
+      min_y_(std::numeric_limits<double>::max()),
+      max_x_(-std::numeric_limits<double>::max()),
+      max_y_(-std::numeric_limits<double>::max())
+    {
+    }
+
+    BoundingBox(double min_x, double min_y, double max_x, double max_y) :
+      min_x_(min_x),
+      min_y_(min_y),
+      max_x_(max_x),
+      max_y_(max_y)
+    {
+    }
+
+    void Clear() { *this = BoundingBox(); }
+
+    bool Empty() const { return min_x_ > max_x_ || min_y_ > max_y_; }
+
+    void Extend(double x, double y)
+    {
+      min_x_ = std::min(min_x_, x);
+      min_y_ = std::min(min_y_, y);
+      max_x_ = std::max(max_x_, x);
+      max_y_ = std::max(max_y_, y);
+    }
+
+    void Extend(const tf::Vector3& point) { Extend(point.x(), point.y()); }
+
+    void Extend(const BoundingBox& box)
+    {
+      if (!box.Empty())
+      {
+        Extend(box.min_x_, box.min_y_);
+        Extend(box.max_x_, box.max_y_);
+      }
+    }
+
+    /**
+     * Grows the box by a distance on every side, e.g. to account for the
+     * size of the points or lines drawn inside it.
+     */
+    void Pad(double distance)
+    {
+      if (!Empty())
+      {
+        min_x_ -= distance;
+        min_y_ -= distance;
+        max_x_ += distance;
+        max_y_ += distance;
+      }
+    }
+
+    bool Intersects(const BoundingBox& other) const
+    {
+      return !Empty() && !other.Empty() &&
+          min_x_ <= other.max_x_ && other.min_x_ <= max_x_ &&
+          min_y_ <= other.max_y_ && other.min_y_ <= max_y_;
+    }
+
+    bool Contains(double x, double y) const
+    {
+      return x >= min_x_ && x <= max_x_ && y >= min_y_ && y <= max_y_;
+    }
+
+    /**
+     * Returns the box containing this box after it has been transformed.
+     * The box is taken to span min_z to max_z, for contents that aren't
+     * flat before they are transformed.
+     */
+    BoundingBox Transformed(const tf::Transform& transform, double min_z = 0.0, double max_z = 0.0) const
+    {
+      BoundingBox box;
+      if (!Empty())
+      {
+        box.Extend(transform * tf::Vector3(min_x_, min_y_, min_z));
+        box.Extend(transform * tf::Vector3(max_x_, min_y_, min_z));
+        box.Extend(transform * tf::Vector3(max_x_, max_y_, min_z));
+        box.Extend(transform * tf::Vector3(min_x_, max_y_, min_z));
+        if (max_z != min_z)
+        {
+          box.Extend(transform * tf::Vector3(min_x_, min_y_, max_z));
+          box.Extend(transform * tf::Vector3(max_x_, min_y_, max_z));
+          box.Extend(transform * tf::Vector3(max_x_, max_y_, max_z));
+          box.Extend(transform * tf::Vector3(min_x_, max_y_, max_z));
+        }
+      }
+      return box;
+    }
+
+    double MinX() const { return min_x_; }
+    double MinY() const { return min_y_; }
+    double MaxX() const { return max_x_; }
+    double MaxY() const { return max_y_; }
+
+  private:
+    double min_x_;
+    double min_y_;
+    double max_x_;
+    double max_y_;
+  };
+
+  /**
+   * Describes the region of the fixed frame a plugin is drawing into.
+   */
+  struct DrawContext
+  {
+    DrawContext() :
+      center_x(0),
+      center_y(0),
+      scale(1),
+      rotation(0),
+      width(0),
+      height(0)
+    {
+    }
+
+    /**
+     * Sets up the context for a view of width x height pixels centered on
+     * (x, y) and rotated by rotation radians.
+     */
+    void SetView(double x, double y, double view_scale, double view_rotation, int view_width, int view_height)
+    {
+      center_x = x;
+      center_y = y;
+      scale = view_scale;
+      rotation = view_rotation;
+      width = view_width;
+      height = view_height;
+
+      // Bounds of the rotated view rectangle
+      const double half_width = 0.5 * width * scale;
+      const double half_height = 0.5 * height * scale;
+      const double cos_r = std::fabs(std::cos(rotation));
+      const double sin_r = std::fabs(std::sin(rotation));
+      const double extent_x = cos_r * half_width + sin_r * half_height;
+      const double extent_y = sin_r * half_width + cos_r * half_height;
+      bounds = BoundingBox(x - extent_x, y - extent_y, x + extent_x, y + extent_y);
+    }
+
+    /**
+     * Returns false if nothing inside the box can be seen.
+     */
+    bool IsVisible(const BoundingBox& box) const
+    {
+      return bounds.Empty() || bounds.Intersects(box);
+    }
+
+    // Center of the view in the fixed frame
+    double center_x;
+    double center_y;
+    // Meters per pixel
+    double scale;
+    // Rotation of the view relative to the fixed frame, including the fixed
+    // orientation and 90 degree rotation options
+    double rotation;
+    // Size of the view in pixels
+    int width;
+    int height;
+    // Everything in the fixed frame that can be seen
+    BoundingBox bounds;
+  };
+}
+
+#endif  // MAPVIZ_DRAW_CONTEXT_H_
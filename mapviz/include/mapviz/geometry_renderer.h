@@ -0,0 +1,242 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_GEOMETRY_RENDERER_H_
+#define MAPVIZ_GEOMETRY_RENDERER_H_
+
+// C++ standard libraries
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+// QT libraries
+#include <QColor>
+#include <QGLWidget>
+
+// ROS libraries
+#include <tf/transform_datatypes.h>
+
+namespace mapviz
+{
+  class MapvizPlugin;
+
+  /**
+   * Retained-mode geometry shared by all plugins on a canvas.
+   *
+   * Plugins create geometry once and only hand it new vertices when their
+   * data changes.  The vertices of every plugin live in one vertex buffer;
+   * only changed ranges are uploaded, and each plugin's geometry is sorted
+   * by render state so that geometry sharing a state is drawn with a single
+   * glMultiDrawArrays() call.  Geometry is drawn by the canvas right after
+   * the plugin that owns it, so the plugins' draw order is kept.
+   *
+   * Geometry can be drawn with a transform, so that its vertices stay in
+   * their source frame.  Transforms are objects of their own that any
+   * number of geometries share; updating one only changes its matrix and
+   * doesn't rebuild any batches.
+   *
+   * This class is only meant to be used from the GUI thread.
+   */
+  class GeometryRenderer
+  {
+  public:
+    enum Primitive
+    {
+      POINTS,
+      LINES,
+      LINE_STRIP,
+      TRIANGLES
+    };
+
+    /**
+     * A vertex of the geometry.  z only matters for geometry with a
+     * transform, which may rotate it into x and y; the canvas drops z after
+     * that.
+     */
+    struct Vertex
+    {
+      float x;
+      float y;
+      float z;
+      float u;
+      float v;
+      uint8_t color[4];
+    };
+
+    struct Style
+    {
+      Style() : primitive(POINTS), size(1.0f), texture(0) {}
+
+      Primitive primitive;
+      // Point size or line width in pixels
+      float size;
+      // Texture to apply with the vertices' texture coordinates, or 0
+      GLuint texture;
+    };
+
+    typedef uint32_t GeometryId;
+    typedef uint32_t TransformId;
+
+    GeometryRenderer();
+
+    GeometryId Create(const MapvizPlugin* owner, const Style& style);
+    void Remove(GeometryId id);
+    void RemoveAll(const MapvizPlugin* owner);
+
+    void SetStyle(GeometryId id, const Style& style);
+    void SetVertices(GeometryId id, const std::vector<Vertex>& vertices);
+    void SetVisible(GeometryId id, bool visible);
+
+    /**
+     * Creates a transform for geometry to be drawn with.  Plugins should
+     * create one per frame and stamp their data is in, rather than one per
+     * geometry, since geometry is only batched with geometry that uses the
+     * same transform.
+     */
+    TransformId CreateTransform(const MapvizPlugin* owner);
+    void RemoveTransform(TransformId id);
+
+    /**
+     * Sets the matrix of a transform, e.g. when tf data changes.
+     */
+    void UpdateTransform(TransformId id, const tf::Transform& transform);
+
+    /**
+     * Draws the geometry with a transform, or without one.  Geometry whose
+     * transform has been removed isn't drawn.
+     */
+    void SetTransform(GeometryId id, TransformId transform);
+    void ClearTransform(GeometryId id);
+
+    /**
+     * Helpers for building vertices.
+     */
+    static Vertex MakeVertex(double x, double y, const QColor& color, double alpha = 1.0);
+    static Vertex MakeVertex(double x, double y, double u, double v);
+
+    /**
+     * Appends a quad as two triangles; use with a TRIANGLES style.
+     */
+    static void AppendQuad(
+        std::vector<Vertex>& vertices,
+        const Vertex& top_left,
+        const Vertex& top_right,
+        const Vertex& bottom_right,
+        const Vertex& bottom_left);
+
+    /**
+     * Draws the visible geometry of one owner.  Must be called with the
+     * canvas's GL context current.
+     */
+    void Draw(const MapvizPlugin* owner);
+
+    /**
+     * Deletes the vertex buffer; must be called with the GL context current.
+     */
+    void DeleteBuffers();
+
+  private:
+    struct Geometry
+    {
+      const MapvizPlugin* owner;
+      Style style;
+      std::vector<Vertex> vertices;
+      // Location of the vertices in the vertex buffer
+      size_t first;
+      size_t capacity;
+      bool visible;
+      // The transform the geometry is drawn with, or 0
+      TransformId transform;
+    };
+
+    struct Transform
+    {
+      const MapvizPlugin* owner;
+      double matrix[16];
+    };
+
+    struct Batch
+    {
+      Style style;
+      TransformId transform;
+      std::vector<GLint> first;
+      std::vector<GLsizei> count;
+    };
+
+    struct Owner
+    {
+      Owner() : dirty(true) {}
+
+      std::set<GeometryId> geometry;
+      std::vector<Batch> batches;
+      bool dirty;
+    };
+
+    void Changed(const Geometry& geometry);
+    void UploadVertices();
+    void BuildBatches(Owner& owner);
+
+    GeometryId next_id_;
+    std::map<GeometryId, Geometry> geometry_;
+    TransformId next_transform_id_;
+    std::map<TransformId, Transform> transforms_;
+    std::map<const MapvizPlugin*, Owner> owners_;
+
+    // Geometry whose vertices need to be uploaded
+    std::set<GeometryId> upload_;
+
+    GLuint vertex_buffer_;
+    // Vertices the buffer can hold, vertices allocated to geometry, and
+    // vertices left unused by geometry that was moved or removed
+    size_t buffer_capacity_;
+    size_t used_;
+    size_t unused_;
+  };
+  typedef boost::shared_ptr<GeometryRenderer> GeometryRendererPtr;
+
+  /**
+   * Converts a transform into a column-major OpenGL matrix for drawing on
+   * the canvas.  The canvas's projection only keeps a thin slab around
+   * z = 0, so the matrix drops z instead of passing it through; otherwise
+   * anything with a z offset, such as a sensor mounted above the target
+   * frame, would be clipped.
+   */
+  inline void GetPlanarGLMatrix(const tf::Transform& transform, double matrix[16])
+  {
+    transform.getOpenGLMatrix(matrix);
+    matrix[2] = 0.0;
+    matrix[6] = 0.0;
+    matrix[10] = 0.0;
+    matrix[14] = 0.0;
+  }
+}
+
+#endif  // MAPVIZ_GEOMETRY_RENDERER_H_
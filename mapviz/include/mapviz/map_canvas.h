@@ -39,6 +39,7 @@
 #include <boost/shared_ptr.hpp>
 
 // QT libraries
+#include <QGLFramebufferObject>
 #include <QGLWidget>
 #include <QMouseEvent>
 #include <QWheelEvent>
@@ -50,7 +51,9 @@
 #include <tf/transform_datatypes.h>
 #include <tf/transform_listener.h>
 
+#include <mapviz/geometry_renderer.h>
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/transform_cache.h>
 
 namespace mapviz
 {
@@ -62,7 +65,9 @@ namespace mapviz
     explicit MapCanvas(QWidget *parent = 0);
     ~MapCanvas();
 
-    void InitializeTf(boost::shared_ptr<tf::TransformListener> tf);
+    void InitializeTf(
+        boost::shared_ptr<tf::TransformListener> tf,
+        swri_transform_util::TransformManagerPtr tf_manager);
 
     void AddPlugin(MapvizPluginPtr plugin, int order);
     void RemovePlugin(MapvizPluginPtr plugin);
@@ -72,6 +77,7 @@ namespace mapviz
     void ToggleRotate90(bool on);
     void ToggleEnableAntialiasing(bool on);
     void ToggleUseLatestTransforms(bool on);
+    void ToggleCacheStaticLayers(bool on);
     void UpdateView();
     void ReorderDisplays();
     void ResetLocation();
@@ -80,6 +86,10 @@ namespace mapviz
 
     double frameRate() const;
 
+    TransformCachePtr GetTransformCache() const { return transform_cache_; }
+
+    GeometryRendererPtr GetGeometryRenderer() const { return geometry_renderer_; }
+
     float ViewScale() const { return view_scale_; }
     float OffsetX() const { return offset_x_; }
     float OffsetY() const { return offset_y_; }
@@ -96,32 +106,37 @@ namespace mapviz
     {
       view_scale_ = scale;
       UpdateView();
+      RequestRedraw();
     }
 
     void SetOffsetX(float x)
     {
       offset_x_ = x;
       UpdateView();
+      RequestRedraw();
     }
 
     void SetOffsetY(float y)
     {
       offset_y_ = y;
       UpdateView();
+      RequestRedraw();
     }
 
     void SetBackground(const QColor& color)
     {
       bg_color_ = color;
-      update();
+      RequestRedraw();
     }
 
     void CaptureFrames(bool enabled)
     {
       capture_frames_ = enabled;
-      update();
+      RequestRedraw();
     }
 
+    bool eventFilter(QObject* object, QEvent* event);
+
     /**
      * Copies the current capture buffer into the target buffer.  The target
      * buffer must already be initialized to a size of:
@@ -168,6 +183,15 @@ namespace mapviz
   public Q_SLOTS:
     void setFrameRate(const double fps);
 
+    /**
+     * Marks the canvas as needing a new frame.  Frames are only drawn when
+     * something has changed, at no more than frameRate() frames per second.
+     */
+    void RequestRedraw();
+
+  protected Q_SLOTS:
+    void ScheduleFrame();
+
   protected:
     void initializeGL();
     void initGlBlending();
@@ -183,10 +207,40 @@ namespace mapviz
 
     void Recenter();
     void TransformTarget(QPainter* painter);
+
+    /**
+     * Returns true if the transform from the fixed frame to the target frame
+     * differs from the one the last frame was drawn with.
+     */
+    bool ViewTransformChanged();
     void Zoom(float factor);
 
     void InitializePixelBuffers();
 
+    /**
+     * An offscreen image of a contiguous run of plugins that support layer
+     * caching, covering a square region of the fixed frame around the view.
+     */
+    struct StaticLayer
+    {
+      boost::shared_ptr<QGLFramebufferObject> fbo;
+      // The plugins drawn into the layer and their data generations
+      std::vector<std::pair<MapvizPluginPtr, uint64_t> > contents;
+      double center_x;
+      double center_y;
+      double half_size;
+      double scale;
+    };
+
+    void DrawStaticLayer(
+        StaticLayer& layer,
+        std::list<MapvizPluginPtr>::iterator begin,
+        std::list<MapvizPluginPtr>::iterator end);
+    bool RenderStaticLayer(
+        StaticLayer& layer,
+        std::list<MapvizPluginPtr>::iterator begin,
+        std::list<MapvizPluginPtr>::iterator end);
+
     bool canvas_able_to_move_ = true;
     bool has_pixel_buffers_;
     int32_t pixel_buffer_size_;
@@ -198,8 +252,14 @@ namespace mapviz
     bool fix_orientation_;
     bool rotate_90_;
     bool enable_antialiasing_;
+    bool cache_static_layers_;
 
+    // Checks at the maximum frame rate whether a new frame is needed
     QTimer frame_rate_timer_;
+    bool redraw_requested_;
+    // The tf generation the last frame is known to be up to date with
+    uint64_t checked_tf_generation_;
+    ros::WallTime last_frame_time_;
 
     QColor bg_color_;
 
@@ -229,6 +289,12 @@ namespace mapviz
     // View scale in meters per pixel
     float view_scale_;
 
+    // Rotation of the view relative to the fixed frame
+    double view_rotation_;
+
+    // The view as seen by plugins
+    DrawContext draw_context_;
+
     // The bounds of the view
     float view_left_;
     float view_right_;
@@ -245,9 +311,17 @@ namespace mapviz
     std::string target_frame_;
 
     boost::shared_ptr<tf::TransformListener> tf_;
+    // Transform lookups made by plugins, shared for the length of a frame
+    TransformCachePtr transform_cache_;
+    // Retained-mode geometry of all plugins
+    GeometryRendererPtr geometry_renderer_;
     tf::StampedTransform transform_;
+    // The fixed frame to target frame transform the last frame was drawn with
+    bool view_transform_valid_;
+    tf::Transform view_transform_;
     QTransform qtransform_;
     std::list<MapvizPluginPtr> plugins_;
+    std::vector<StaticLayer> static_layers_;
 
     std::vector<uint8_t> capture_buffer_;
   };
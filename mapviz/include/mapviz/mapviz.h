@@ -105,6 +105,7 @@ namespace mapviz
     void ToggleFixOrientation(bool on);
     void ToggleRotate90(bool on);
     void ToggleEnableAntialiasing(bool on);
+    void ToggleCacheStaticLayers(bool on);
     void ToggleShowPlugin(QListWidgetItem* item, bool visible);
     void ToggleRecord(bool on);
     void SetImageTransport(QAction* transport_action);
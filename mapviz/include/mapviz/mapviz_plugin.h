@@ -31,6 +31,7 @@
 #define MAPVIZ_MAPVIZ_PLUGIN_H_
 
 // C++ standard libraries
+#include <atomic>
 #include <string>
 
 #include <boost/make_shared.hpp>
@@ -48,6 +49,9 @@
 #include <swri_transform_util/transform_manager.h>
 #include <swri_yaml_util/yaml_util.h>
 
+#include <mapviz/draw_context.h>
+#include <mapviz/geometry_renderer.h>
+#include <mapviz/transform_cache.h>
 #include <mapviz/widgets.h>
 
 #include "stopwatch.h"
@@ -91,6 +95,8 @@ namespace mapviz
       if (value != use_latest_transforms_)
       {
         use_latest_transforms_ = value;
+        data_generation_++;
+        RequestRedraw();
         Q_EMIT UseLatestTransformsChanged(use_latest_transforms_);
       }
     }
@@ -110,6 +116,7 @@ namespace mapviz
       if (draw_order_ != order)
       {
         draw_order_ = order;
+        RequestRedraw();
         Q_EMIT DrawOrderChanged(draw_order_);
       }
     }
@@ -123,12 +130,14 @@ namespace mapviz
     {
       if (visible_ && initialized_)
       {
-        meas_transform_.start();
-        Transform();
-        meas_transform_.stop();
+        TransformIfNeeded();
 
         meas_draw_.start();
         Draw(x, y, scale);
+        if (geometry_renderer_)
+        {
+          geometry_renderer_->Draw(this);
+        }
         meas_draw_.stop();
       }
     }
@@ -137,13 +146,23 @@ namespace mapviz
     {
       if (visible_ && initialized_)
       {
-        meas_transform_.start();
-        Transform();
-        meas_transform_.stop();
-         
+        TransformIfNeeded();
+
         meas_paint_.start();
         Paint(painter, x, y, scale);
-        meas_paint_.start();
+        meas_paint_.stop();
+      }
+    }
+
+    /**
+     * Brings the plugin's transformed data up to date without drawing it;
+     * used when the canvas draws the plugin from a cached layer.
+     */
+    void TransformPlugin()
+    {
+      if (visible_ && initialized_)
+      {
+        TransformIfNeeded();
       }
     }
 
@@ -152,6 +171,8 @@ namespace mapviz
       if (frame_id != target_frame_)
       {
         target_frame_ = frame_id;
+        data_generation_++;
+        RequestRedraw();
 
         meas_transform_.start();
         Transform();
@@ -168,6 +189,8 @@ namespace mapviz
       if (visible_ != visible)
       {
         visible_ = visible;
+        data_generation_++;
+        RequestRedraw();
         Q_EMIT VisibleChanged(visible_);
       }
     }
@@ -191,7 +214,7 @@ namespace mapviz
         return false;
       }
 
-      if (tf_manager_->GetTransform(target_frame_, source_frame_, time, transform))
+      if (LookupTransform(target_frame_, source_frame_, time, transform))
       {
         return true;
       }
@@ -199,7 +222,7 @@ namespace mapviz
       {
         // If the stamped transform failed because it is too recent, find the
         // most recent transform in the cache instead.
-        if (tf_manager_->GetTransform(target_frame_, source_frame_,  ros::Time(), transform))
+        if (LookupTransform(target_frame_, source_frame_,  ros::Time(), transform))
         {
           return true;
         }
@@ -209,6 +232,17 @@ namespace mapviz
     }
     
     bool GetTransform(const std::string& source, const ros::Time& stamp, swri_transform_util::Transform& transform)
+    {
+      return GetTransform(target_frame_, source, stamp, transform);
+    }
+
+    /**
+     * Looks up the transform from source into an explicitly given target
+     * frame.  Plugins that transform data off the GUI thread use this with
+     * their own copy of the target frame, since target_frame_ may change
+     * at any time on the GUI thread.
+     */
+    bool GetTransform(const std::string& target, const std::string& source, const ros::Time& stamp, swri_transform_util::Transform& transform)
     {
       if (!initialized_)
         return false;
@@ -227,7 +261,7 @@ namespace mapviz
         return false;
       }
 
-      if (tf_manager_->GetTransform(target_frame_, source, time, transform))
+      if (LookupTransform(target, source, time, transform))
       {
         return true;
       }
@@ -235,7 +269,7 @@ namespace mapviz
       {
         // If the stamped transform failed because it is too recent, find the
         // most recent transform in the cache instead.
-        if (tf_manager_->GetTransform(target_frame_, source,  ros::Time(), transform))
+        if (LookupTransform(target, source,  ros::Time(), transform))
         {
           return true;
         }
@@ -244,6 +278,48 @@ namespace mapviz
       return false;
     }
 
+    /**
+     * Shares the canvas's per-frame transform cache with this plugin; all
+     * GetTransform() lookups go through it once it is set.
+     */
+    void SetTransformCache(TransformCachePtr transform_cache)
+    {
+      transform_cache_ = transform_cache;
+    }
+
+    /**
+     * Describes the region being drawn; set by the canvas before every call
+     * to DrawPlugin() and PaintPlugin().
+     */
+    void SetDrawContext(const DrawContext& context)
+    {
+      draw_context_ = context;
+    }
+
+    /**
+     * Shares the canvas's retained-mode geometry renderer with this plugin;
+     * geometry the plugin adds to it is drawn right after Draw().
+     */
+    void SetGeometryRenderer(GeometryRendererPtr geometry_renderer)
+    {
+      geometry_renderer_ = geometry_renderer;
+    }
+
+    /**
+     * Returns true once after RequestRedraw() has been called; polled by the
+     * canvas to decide whether a new frame needs to be drawn.
+     */
+    bool TakeRedrawRequest()
+    {
+      return redraw_requested_.exchange(false);
+    }
+
+    /**
+     * Changes whenever DataChanged() is called or the visibility, target
+     * frame or transform settings change.
+     */
+    uint64_t DataGeneration() const { return data_generation_; }
+
     virtual void Transform() = 0;
 
     virtual void LoadConfig(const YAML::Node& load, const std::string& path) = 0;
@@ -281,6 +357,16 @@ namespace mapviz
       return false;
     }
 
+    /**
+     * Override this to return "true" if what the plugin draws only changes
+     * when DataChanged() is called or the view moves.  Such plugins may be
+     * drawn once into an offscreen layer that is reused between frames.
+     */
+    virtual bool SupportsLayerCaching()
+    {
+      return false;
+    }
+
   Q_SIGNALS:
     void DrawOrderChanged(int draw_order);
     void SizeChanged();
@@ -310,6 +396,38 @@ namespace mapviz
 
     int draw_order_;
 
+    TransformCachePtr transform_cache_;
+
+    GeometryRendererPtr geometry_renderer_;
+
+    // The visible part of the fixed frame, for skipping items that can't be
+    // seen
+    DrawContext draw_context_;
+
+    /**
+     * Plugins that set this promise to call DataChanged() whenever their
+     * data changes, so Transform() is skipped on frames where neither their
+     * data, the target frame nor any tf data changed.  Otherwise Transform()
+     * still runs once per frame.
+     */
+    bool transform_on_change_;
+
+    /**
+     * Marks the plugin's data as needing Transform() on the next frame.
+     */
+    void DataChanged()
+    {
+      data_generation_++;
+      RequestRedraw();
+    }
+
+    /**
+     * Asks the canvas to draw a new frame.  Requests are coalesced and the
+     * frame is drawn no faster than the canvas's maximum frame rate.  Safe
+     * to call from any thread.
+     */
+    void RequestRedraw() { redraw_requested_ = true; }
+
     virtual bool Initialize(QGLWidget* canvas) = 0;
 
     MapvizPlugin() :
@@ -321,14 +439,81 @@ namespace mapviz
       target_frame_(""),
       source_frame_(""),
       use_latest_transforms_(false),
-      draw_order_(0) {}
+      draw_order_(0),
+      transform_on_change_(false),
+      data_generation_(0),
+      transformed_generation_(0),
+      transformed_tf_generation_(0),
+      transformed_frame_(0),
+      redraw_requested_(true) {}
 
    private:
+    /**
+     * Runs Transform() at most once per frame; DrawPlugin() and
+     * PaintPlugin() both need transformed data but the second call would
+     * only repeat the first.
+     */
+    void TransformIfNeeded()
+    {
+      uint64_t frame = 0;
+      uint64_t tf_generation = 0;
+      if (transform_cache_)
+      {
+        frame = transform_cache_->Frame();
+        tf_generation = transform_cache_->FrameTfGeneration();
+      }
+
+      bool needed = true;
+      if (frame != 0 && transformed_frame_ != 0 &&
+          data_generation_ == transformed_generation_)
+      {
+        needed = frame != transformed_frame_ &&
+            (!transform_on_change_ || tf_generation != transformed_tf_generation_);
+      }
+
+      if (!needed)
+      {
+        meas_transform_.skip();
+        return;
+      }
+
+      // Record the state before transforming so that anything that changes
+      // while Transform() runs is picked up on the next frame.
+      transformed_generation_ = data_generation_;
+      transformed_tf_generation_ = tf_generation;
+      transformed_frame_ = frame;
+
+      meas_transform_.start();
+      Transform();
+      meas_transform_.stop();
+    }
+
+    bool LookupTransform(
+        const std::string& target,
+        const std::string& source,
+        const ros::Time& stamp,
+        swri_transform_util::Transform& transform)
+    {
+      if (transform_cache_)
+      {
+        return transform_cache_->GetTransform(target, source, stamp, transform);
+      }
+      return tf_manager_->GetTransform(target, source, stamp, transform);
+    }
+
     // Collect basic profiling info to know how much time each plugin
     // spends in Transform(), Paint(), and Draw().
     Stopwatch meas_transform_;
     Stopwatch meas_paint_;
     Stopwatch meas_draw_;
+
+    // Inputs to the last Transform() run by TransformIfNeeded().
+    uint64_t data_generation_;
+    uint64_t transformed_generation_;
+    uint64_t transformed_tf_generation_;
+    uint64_t transformed_frame_;
+
+    std::atomic<bool> redraw_requested_;
   };
   typedef boost::shared_ptr<MapvizPlugin> MapvizPluginPtr;
 
@@ -0,0 +1,331 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_SPATIAL_INDEX_H_
+#define MAPVIZ_SPATIAL_INDEX_H_
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <mapviz/draw_context.h>
+
+namespace mapviz
+{
+  /**
+   * Finds the items whose bounding boxes overlap a region without looking at
+   * every item.
+   *
+   * Items are stored in a hierarchy of uniform grids whose cell size doubles
+   * from one level to the next.  Each item goes into the level where its box
+   * covers at most 2x2 cells, so small and very large items (a parking spot
+   * and a 2 km lane, say) are both cheap to insert, move and find.  Items are
+   * added, moved and removed one at a time; there is no rebuild step.
+   *
+   * Not thread safe.
+   */
+  template <class Key, class Hash = std::hash<Key> >
+  class SpatialIndex
+  {
+  public:
+    static const int MAX_LEVEL = 31;
+
+    /**
+     * @param cell_size Size of the smallest grid cells, in the same units as
+     *                  the boxes that will be stored.
+     */
+    explicit SpatialIndex(double cell_size = 1.0) :
+      query_(0)
+    {
+      cell_sizes_.resize(MAX_LEVEL + 1);
+      for (int i = 0; i <= MAX_LEVEL; i++)
+      {
+        cell_sizes_[i] = std::ldexp(cell_size, i);
+      }
+      levels_.resize(MAX_LEVEL + 1);
+    }
+
+    /**
+     * Adds an item or updates the box of one already in the index.  Items
+     * with an empty box are removed.
+     */
+    void Insert(const Key& key, const BoundingBox& box)
+    {
+      if (box.Empty())
+      {
+        Remove(key);
+        return;
+      }
+
+      CellRange range = GetRange(box);
+      std::pair<typename EntryMap::iterator, bool> result = entries_.emplace(key, Entry());
+      Entry& entry = result.first->second;
+      entry.box = box;
+
+      if (!result.second)
+      {
+        if (entry.range == range)
+        {
+          return;
+        }
+        Unlink(entry);
+      }
+
+      entry.key = &result.first->first;
+      entry.range = range;
+      entry.query = 0;
+      Link(entry);
+    }
+
+    void Remove(const Key& key)
+    {
+      typename EntryMap::iterator it = entries_.find(key);
+      if (it != entries_.end())
+      {
+        Unlink(it->second);
+        entries_.erase(it);
+      }
+    }
+
+    void Clear()
+    {
+      entries_.clear();
+      for (size_t i = 0; i < levels_.size(); i++)
+      {
+        levels_[i].clear();
+      }
+    }
+
+    size_t Size() const { return entries_.size(); }
+
+    /**
+     * Calls visitor(key) once for every item whose box intersects the
+     * region.  The visitor must not modify the index.
+     */
+    template <class Visitor>
+    void Query(const BoundingBox& region, Visitor visitor) const
+    {
+      if (region.Empty())
+      {
+        return;
+      }
+
+      // Items that span more than one cell are seen more than once; the
+      // query stamp makes sure they are only reported the first time.
+      query_++;
+      for (int level = 0; level <= MAX_LEVEL; level++)
+      {
+        const CellMap& cells = levels_[level];
+        if (cells.empty())
+        {
+          continue;
+        }
+
+        CellRange range = GetRange(region, level);
+        const double num_cells =
+            (static_cast<double>(range.max_i - range.min_i) + 1.0) *
+            (static_cast<double>(range.max_j - range.min_j) + 1.0);
+        if (num_cells <= cells.size())
+        {
+          for (int64_t i = range.min_i; i <= range.max_i; i++)
+          {
+            for (int64_t j = range.min_j; j <= range.max_j; j++)
+            {
+              typename CellMap::const_iterator cell = cells.find(CellKey(i, j));
+              if (cell != cells.end())
+              {
+                Visit(cell->second, region, visitor);
+              }
+            }
+          }
+        }
+        else
+        {
+          // The region covers more cells than are in use, so it's cheaper to
+          // check the ones that are.
+          typename CellMap::const_iterator cell = cells.begin();
+          for (; cell != cells.end(); ++cell)
+          {
+            int64_t i, j;
+            SplitCellKey(cell->first, i, j);
+            if (i >= range.min_i && i <= range.max_i && j >= range.min_j && j <= range.max_j)
+            {
+              Visit(cell->second, region, visitor);
+            }
+          }
+        }
+      }
+    }
+
+    /**
+     * Appends the keys of the items whose box intersects the region.
+     */
+    void Query(const BoundingBox& region, std::vector<Key>& keys) const
+    {
+      Query(region, [&keys](const Key& key) { keys.push_back(key); });
+    }
+
+  private:
+    struct CellRange
+    {
+      int level;
+      int64_t min_i;
+      int64_t min_j;
+      int64_t max_i;
+      int64_t max_j;
+
+      bool operator==(const CellRange& other) const
+      {
+        return level == other.level &&
+            min_i == other.min_i && min_j == other.min_j &&
+            max_i == other.max_i && max_j == other.max_j;
+      }
+    };
+
+    struct Entry
+    {
+      const Key* key;
+      BoundingBox box;
+      CellRange range;
+      mutable uint64_t query;
+    };
+
+    typedef std::unordered_map<Key, Entry, Hash> EntryMap;
+    typedef std::unordered_map<uint64_t, std::vector<const Entry*> > CellMap;
+
+    static uint64_t CellKey(int64_t i, int64_t j)
+    {
+      return (static_cast<uint64_t>(static_cast<uint32_t>(i)) << 32) |
+          static_cast<uint64_t>(static_cast<uint32_t>(j));
+    }
+
+    static void SplitCellKey(uint64_t key, int64_t& i, int64_t& j)
+    {
+      i = static_cast<int32_t>(static_cast<uint32_t>(key >> 32));
+      j = static_cast<int32_t>(static_cast<uint32_t>(key));
+    }
+
+    int64_t CellIndex(double value, int level) const
+    {
+      const double index = std::floor(value / cell_sizes_[level]);
+      return static_cast<int64_t>(std::max(-2147483648.0, std::min(2147483647.0, index)));
+    }
+
+    CellRange GetRange(const BoundingBox& box, int level) const
+    {
+      CellRange range;
+      range.level = level;
+      range.min_i = CellIndex(box.MinX(), level);
+      range.min_j = CellIndex(box.MinY(), level);
+      range.max_i = CellIndex(box.MaxX(), level);
+      range.max_j = CellIndex(box.MaxY(), level);
+      return range;
+    }
+
+    /**
+     * Picks the smallest level whose cells are at least as big as the box.
+     */
+    CellRange GetRange(const BoundingBox& box) const
+    {
+      const double extent = std::max(box.MaxX() - box.MinX(), box.MaxY() - box.MinY());
+      int level = 0;
+      while (level < MAX_LEVEL && cell_sizes_[level] < extent)
+      {
+        level++;
+      }
+      return GetRange(box, level);
+    }
+
+    void Link(const Entry& entry)
+    {
+      CellMap& cells = levels_[entry.range.level];
+      for (int64_t i = entry.range.min_i; i <= entry.range.max_i; i++)
+      {
+        for (int64_t j = entry.range.min_j; j <= entry.range.max_j; j++)
+        {
+          cells[CellKey(i, j)].push_back(&entry);
+        }
+      }
+    }
+
+    void Unlink(const Entry& entry)
+    {
+      CellMap& cells = levels_[entry.range.level];
+      for (int64_t i = entry.range.min_i; i <= entry.range.max_i; i++)
+      {
+        for (int64_t j = entry.range.min_j; j <= entry.range.max_j; j++)
+        {
+          typename CellMap::iterator cell = cells.find(CellKey(i, j));
+          if (cell == cells.end())
+          {
+            continue;
+          }
+
+          std::vector<const Entry*>& items = cell->second;
+          typename std::vector<const Entry*>::iterator item =
+              std::find(items.begin(), items.end(), &entry);
+          if (item != items.end())
+          {
+            *item = items.back();
+            items.pop_back();
+          }
+          if (items.empty())
+          {
+            cells.erase(cell);
+          }
+        }
+      }
+    }
+
+    template <class Visitor>
+    void Visit(const std::vector<const Entry*>& items, const BoundingBox& region, Visitor& visitor) const
+    {
+      for (size_t i = 0; i < items.size(); i++)
+      {
+        const Entry* entry = items[i];
+        if (entry->query != query_ && entry->box.Intersects(region))
+        {
+          entry->query = query_;
+          visitor(*entry->key);
+        }
+      }
+    }
+
+    std::vector<double> cell_sizes_;
+    EntryMap entries_;
+    std::vector<CellMap> levels_;
+    mutable uint64_t query_;
+  };
+}
+
+#endif  // MAPVIZ_SPATIAL_INDEX_H_
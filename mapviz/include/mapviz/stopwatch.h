@@ -43,7 +43,8 @@ class Stopwatch
  public:
   Stopwatch()
     :
-    count_(0)
+    count_(0),
+    skipped_(0)
   {
   }
 
@@ -64,9 +65,20 @@ class Stopwatch
     max_time_ = std::max(max_time_, dt);
   }
 
+  /* Record an interval that was skipped because its work was not
+   * needed.
+   */
+  void skip()
+  {
+    skipped_ += 1;
+  }
+
   /* Return the number of intervals measured. */
   int count() const { return count_; }
 
+  /* Return the number of intervals skipped. */
+  int skipped() const { return skipped_; }
+
   /* Returns the longest observed duration. */
   ros::WallDuration maxTime() const { return max_time_; }
 
@@ -88,22 +100,25 @@ class Stopwatch
   {
     if (count_)
     {
-      ROS_INFO("%s -- calls: %d, avg time: %.2fms, max time: %.2fms",
+      ROS_INFO("%s -- calls: %d, skipped: %d, avg time: %.2fms, max time: %.2fms",
                name.c_str(),
                count_,
+               skipped_,
                avgTime().toSec()*1000.0,
                maxTime().toSec()*1000.0);
     }
     else
     {
-      ROS_INFO("%s -- calls: %d, avg time: --ms, max time: --ms",
+      ROS_INFO("%s -- calls: %d, skipped: %d, avg time: --ms, max time: --ms",
                name.c_str(),
-               count_);
+               count_,
+               skipped_);
     }
   }
 
  private:
   int count_;
+  int skipped_;
   ros::WallDuration total_time_;
   ros::WallDuration max_time_;
 
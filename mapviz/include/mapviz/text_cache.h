@@ -0,0 +1,102 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_TEXT_CACHE_H_
+#define MAPVIZ_TEXT_CACHE_H_
+
+// C++ standard libraries
+#include <cstddef>
+#include <cstdint>
+
+// QT libraries
+#include <QFont>
+#include <QHash>
+#include <QStaticText>
+#include <QString>
+
+namespace mapviz
+{
+  /**
+   * Laid out text for plugins that paint many labels.
+   *
+   * Each distinct string is shaped once into a QStaticText and reused for as
+   * long as it keeps being drawn.  Qt's OpenGL paint engine keeps the glyphs
+   * of static text in its glyph texture cache and reuses their vertex
+   * arrays, so drawing a cached string with QPainter::drawStaticText() skips
+   * both text layout and glyph rasterization.
+   *
+   * This class is only meant to be used from the GUI thread.
+   */
+  class TextCache
+  {
+  public:
+    /**
+     * @param[in] max_size Number of strings kept before ones that weren't
+     *                     used since the last call to Trim() are dropped.
+     */
+    explicit TextCache(std::size_t max_size = 4096);
+
+    /**
+     * Sets the font that text is laid out in.  Changing it drops every
+     * cached string.
+     */
+    void SetFont(const QFont& font);
+    const QFont& Font() const { return font_; }
+
+    /**
+     * Returns the laid out text for a string, laying it out if it isn't
+     * cached.  QStaticText is implicitly shared, so the copy is cheap.
+     */
+    QStaticText Get(const QString& text);
+
+    /**
+     * Drops the strings that weren't used since the last call if there are
+     * more than max_size of them.  Meant to be called once per frame.
+     */
+    void Trim();
+
+    void Clear();
+
+    std::size_t Size() const { return static_cast<std::size_t>(entries_.size()); }
+
+  private:
+    struct Entry
+    {
+      QStaticText text;
+      uint32_t last_used;
+    };
+
+    QFont font_;
+    QHash<QString, Entry> entries_;
+    std::size_t max_size_;
+    uint32_t frame_;
+  };
+}
+
+#endif  // MAPVIZ_TEXT_CACHE_H_
@@ -0,0 +1,238 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_TRANSFORM_CACHE_H_
+#define MAPVIZ_TRANSFORM_CACHE_H_
+
+// C++ standard libraries
+#include <atomic>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+
+// QT libraries
+#include <QMutex>
+
+// ROS libraries
+#include <ros/time.h>
+#include <tf/transform_listener.h>
+#include <swri_transform_util/transform.h>
+#include <swri_transform_util/transform_manager.h>
+
+namespace mapviz
+{
+  /**
+   * Remembers the result of every transform lookup made while drawing a
+   * frame, so that plugins asking for the same transform many times (once
+   * per marker, say) only hit the transform manager once.
+   *
+   * Lookups are keyed on the target frame, source frame and stamp, with
+   * stamps rounded to STAMP_QUANTUM_NS.  Each entry is looked up again the
+   * first time it is used in a new frame, so tf data that arrives while a
+   * frame is drawn is picked up by the next one.  Entries that go unused
+   * for STALE_FRAMES frames are dropped.  It is safe to use from more than
+   * one thread.
+   */
+  class TransformCache
+  {
+  public:
+    static const int64_t STAMP_QUANTUM_NS = 1000000;
+    static const uint64_t STALE_FRAMES = 250;
+
+    TransformCache() :
+      frame_(0),
+      tf_generation_(0),
+      frame_tf_generation_(0)
+    {
+    }
+
+    ~TransformCache()
+    {
+      if (tf_)
+      {
+        tf_->removeTransformsChangedListener(tf_connection_);
+      }
+    }
+
+    void Initialize(
+        boost::shared_ptr<tf::TransformListener> tf,
+        swri_transform_util::TransformManagerPtr tf_manager)
+    {
+      QMutexLocker locker(&mutex_);
+      if (tf_)
+      {
+        tf_->removeTransformsChangedListener(tf_connection_);
+      }
+      tf_ = tf;
+      tf_manager_ = tf_manager;
+      tf_connection_ = tf_->addTransformsChangedListener(
+          boost::bind(&TransformCache::TransformsChanged, this));
+      entries_.clear();
+    }
+
+    /**
+     * Called by the canvas before it draws a frame.
+     */
+    void NewFrame()
+    {
+      QMutexLocker locker(&mutex_);
+      frame_++;
+      frame_tf_generation_ = tf_generation_;
+
+      std::map<Key, Entry>::iterator it = entries_.begin();
+      while (it != entries_.end())
+      {
+        if (it->second.frame + STALE_FRAMES < frame_)
+        {
+          it = entries_.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+
+    /**
+     * Number of the frame currently being drawn.
+     */
+    uint64_t Frame() const { return frame_; }
+
+    /**
+     * Incremented whenever new tf data arrives.
+     */
+    uint64_t TfGeneration() const { return tf_generation_; }
+
+    /**
+     * The tf generation when the current frame started, which is the tf
+     * data the cached transforms were looked up from.
+     */
+    uint64_t FrameTfGeneration() const { return frame_tf_generation_; }
+
+    /**
+     * Looks up every cached transform again and returns true if any of them
+     * differs from the cached result.  Lets the canvas skip drawing a frame
+     * for tf data that nothing on it depends on.
+     */
+    bool LookupsChanged()
+    {
+      QMutexLocker locker(&mutex_);
+      if (!tf_manager_)
+      {
+        return false;
+      }
+
+      std::map<Key, Entry>::const_iterator it;
+      for (it = entries_.begin(); it != entries_.end(); ++it)
+      {
+        swri_transform_util::Transform transform;
+        bool valid = tf_manager_->GetTransform(
+            std::get<0>(it->first), std::get<1>(it->first), it->second.stamp, transform);
+        if (valid != it->second.valid)
+        {
+          return true;
+        }
+        if (valid &&
+            (transform.GetOrigin() != it->second.transform.GetOrigin() ||
+             transform.GetOrientation() != it->second.transform.GetOrientation()))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    bool GetTransform(
+        const std::string& target,
+        const std::string& source,
+        const ros::Time& stamp,
+        swri_transform_util::Transform& transform)
+    {
+      QMutexLocker locker(&mutex_);
+      if (!tf_manager_)
+      {
+        return false;
+      }
+
+      const Key key(target, source, stamp.toNSec() / STAMP_QUANTUM_NS);
+      std::pair<std::map<Key, Entry>::iterator, bool> inserted =
+          entries_.insert(std::make_pair(key, Entry()));
+      Entry& entry = inserted.first->second;
+      if (inserted.second || entry.frame != frame_)
+      {
+        // Failed lookups are remembered too; they are retried on the next
+        // frame.
+        entry.stamp = stamp;
+        entry.frame = frame_;
+        entry.valid = tf_manager_->GetTransform(target, source, stamp, entry.transform);
+      }
+
+      if (entry.valid)
+      {
+        transform = entry.transform;
+      }
+      return entry.valid;
+    }
+
+  private:
+    typedef std::tuple<std::string, std::string, int64_t> Key;
+
+    struct Entry
+    {
+      // The stamp the transform was looked up at and the frame it was
+      // last looked up for
+      ros::Time stamp;
+      uint64_t frame;
+      bool valid;
+      swri_transform_util::Transform transform;
+    };
+
+    // Called from the tf listener's thread
+    void TransformsChanged()
+    {
+      tf_generation_++;
+    }
+
+    QMutex mutex_;
+    boost::shared_ptr<tf::TransformListener> tf_;
+    swri_transform_util::TransformManagerPtr tf_manager_;
+    boost::signals2::connection tf_connection_;
+
+    uint64_t frame_;
+    std::atomic<uint64_t> tf_generation_;
+    uint64_t frame_tf_generation_;
+    std::map<Key, Entry> entries_;
+  };
+  typedef boost::shared_ptr<TransformCache> TransformCachePtr;
+}
+
+#endif  // MAPVIZ_TRANSFORM_CACHE_H_
@@ -0,0 +1,536 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include <mapviz/geometry_renderer.h>
+
+// C++ standard libraries
+#include <algorithm>
+#include <cstddef>
+
+namespace mapviz
+{
+  namespace
+  {
+    GLenum ToGlMode(GeometryRenderer::Primitive primitive)
+    {
+      switch (primitive)
+      {
+        case GeometryRenderer::LINES:
+          return GL_LINES;
+        case GeometryRenderer::LINE_STRIP:
+          return GL_LINE_STRIP;
+        case GeometryRenderer::TRIANGLES:
+          return GL_TRIANGLES;
+        case GeometryRenderer::POINTS:
+        default:
+          return GL_POINTS;
+      }
+    }
+  }
+
+  GeometryRenderer::GeometryRenderer() :
+    next_id_(1),
+    next_transform_id_(1),
+    vertex_buffer_(0),
+    buffer_capacity_(0),
+    used_(0),
+    unused_(0)
+  {
+  }
+
+  GeometryRenderer::GeometryId GeometryRenderer::Create(
+      const MapvizPlugin* owner,
+      const Style& style)
+  {
+    GeometryId id = next_id_++;
+
+    Geometry& geometry = geometry_[id];
+    geometry.owner = owner;
+    geometry.style = style;
+    geometry.first = 0;
+    geometry.capacity = 0;
+    geometry.visible = true;
+    geometry.transform = 0;
+
+    Owner& entry = owners_[owner];
+    entry.geometry.insert(id);
+    entry.dirty = true;
+
+    return id;
+  }
+
+  void GeometryRenderer::Remove(GeometryId id)
+  {
+    std::map<GeometryId, Geometry>::iterator it = geometry_.find(id);
+    if (it == geometry_.end())
+    {
+      return;
+    }
+
+    unused_ += it->second.capacity;
+    upload_.erase(id);
+
+    std::map<const MapvizPlugin*, Owner>::iterator owner = owners_.find(it->second.owner);
+    owner->second.geometry.erase(id);
+    owner->second.dirty = true;
+    if (owner->second.geometry.empty())
+    {
+      owners_.erase(owner);
+    }
+
+    geometry_.erase(it);
+  }
+
+  void GeometryRenderer::RemoveAll(const MapvizPlugin* owner)
+  {
+    std::map<const MapvizPlugin*, Owner>::iterator entry = owners_.find(owner);
+    if (entry == owners_.end())
+    {
+      return;
+    }
+
+    std::set<GeometryId>::const_iterator it;
+    for (it = entry->second.geometry.begin(); it != entry->second.geometry.end(); ++it)
+    {
+      unused_ += geometry_[*it].capacity;
+      upload_.erase(*it);
+      geometry_.erase(*it);
+    }
+    owners_.erase(entry);
+
+    std::map<TransformId, Transform>::iterator transform = transforms_.begin();
+    while (transform != transforms_.end())
+    {
+      if (transform->second.owner == owner)
+      {
+        transforms_.erase(transform++);
+      }
+      else
+      {
+        ++transform;
+      }
+    }
+  }
+
+  void GeometryRenderer::SetStyle(GeometryId id, const Style& style)
+  {
+    std::map<GeometryId, Geometry>::iterator it = geometry_.find(id);
+    if (it == geometry_.end())
+    {
+      return;
+    }
+
+    const Style& current = it->second.style;
+    if (current.primitive != style.primitive ||
+        current.size != style.size ||
+        current.texture != style.texture)
+    {
+      it->second.style = style;
+      Changed(it->second);
+    }
+  }
+
+  void GeometryRenderer::SetVertices(GeometryId id, const std::vector<Vertex>& vertices)
+  {
+    std::map<GeometryId, Geometry>::iterator it = geometry_.find(id);
+    if (it == geometry_.end())
+    {
+      return;
+    }
+
+    Geometry& geometry = it->second;
+    bool resized = vertices.size() != geometry.vertices.size();
+    geometry.vertices = vertices;
+
+    if (geometry.vertices.size() > geometry.capacity)
+    {
+      // Move the geometry to the end of the buffer with some room to grow;
+      // the space it leaves behind is reclaimed by UploadVertices().
+      unused_ += geometry.capacity;
+      geometry.capacity = std::max(
+          static_cast<size_t>(16),
+          geometry.vertices.size() + geometry.vertices.size() / 2);
+      geometry.first = used_;
+      used_ += geometry.capacity;
+      resized = true;
+    }
+
+    upload_.insert(id);
+
+    // Batches only need to be rebuilt if the vertex range changed.
+    if (resized)
+    {
+      Changed(geometry);
+    }
+  }
+
+  void GeometryRenderer::SetVisible(GeometryId id, bool visible)
+  {
+    std::map<GeometryId, Geometry>::iterator it = geometry_.find(id);
+    if (it != geometry_.end() && it->second.visible != visible)
+    {
+      it->second.visible = visible;
+      Changed(it->second);
+    }
+  }
+
+  GeometryRenderer::TransformId GeometryRenderer::CreateTransform(const MapvizPlugin* owner)
+  {
+    TransformId id = next_transform_id_++;
+
+    Transform& transform = transforms_[id];
+    transform.owner = owner;
+    GetPlanarGLMatrix(tf::Transform::getIdentity(), transform.matrix);
+
+    return id;
+  }
+
+  void GeometryRenderer::RemoveTransform(TransformId id)
+  {
+    transforms_.erase(id);
+  }
+
+  void GeometryRenderer::UpdateTransform(TransformId id, const tf::Transform& transform)
+  {
+    // Batches refer to the transform by id and read the matrix when they
+    // are drawn, so nothing else changes.
+    std::map<TransformId, Transform>::iterator it = transforms_.find(id);
+    if (it != transforms_.end())
+    {
+      GetPlanarGLMatrix(transform, it->second.matrix);
+    }
+  }
+
+  void GeometryRenderer::SetTransform(GeometryId id, TransformId transform)
+  {
+    std::map<GeometryId, Geometry>::iterator it = geometry_.find(id);
+    if (it != geometry_.end() && it->second.transform != transform)
+    {
+      it->second.transform = transform;
+      Changed(it->second);
+    }
+  }
+
+  void GeometryRenderer::ClearTransform(GeometryId id)
+  {
+    SetTransform(id, 0);
+  }
+
+  GeometryRenderer::Vertex GeometryRenderer::MakeVertex(
+      double x,
+      double y,
+      const QColor& color,
+      double alpha)
+  {
+    Vertex vertex;
+    vertex.x = static_cast<float>(x);
+    vertex.y = static_cast<float>(y);
+    vertex.z = 0.0f;
+    vertex.u = 0.0f;
+    vertex.v = 0.0f;
+    vertex.color[0] = static_cast<uint8_t>(color.red());
+    vertex.color[1] = static_cast<uint8_t>(color.green());
+    vertex.color[2] = static_cast<uint8_t>(color.blue());
+    vertex.color[3] = static_cast<uint8_t>(std::max(0.0, std::min(1.0, alpha)) * 255.0 + 0.5);
+    return vertex;
+  }
+
+  GeometryRenderer::Vertex GeometryRenderer::MakeVertex(
+      double x,
+      double y,
+      double u,
+      double v)
+  {
+    Vertex vertex;
+    vertex.x = static_cast<float>(x);
+    vertex.y = static_cast<float>(y);
+    vertex.z = 0.0f;
+    vertex.u = static_cast<float>(u);
+    vertex.v = static_cast<float>(v);
+    std::fill(vertex.color, vertex.color + 4, 255);
+    return vertex;
+  }
+
+  void GeometryRenderer::AppendQuad(
+      std::vector<Vertex>& vertices,
+      const Vertex& top_left,
+      const Vertex& top_right,
+      const Vertex& bottom_right,
+      const Vertex& bottom_left)
+  {
+    vertices.push_back(top_left);
+    vertices.push_back(top_right);
+    vertices.push_back(bottom_right);
+
+    vertices.push_back(top_left);
+    vertices.push_back(bottom_right);
+    vertices.push_back(bottom_left);
+  }
+
+  void GeometryRenderer::Draw(const MapvizPlugin* owner)
+  {
+    std::map<const MapvizPlugin*, Owner>::iterator entry = owners_.find(owner);
+    if (entry == owners_.end())
+    {
+      return;
+    }
+
+    UploadVertices();
+
+    if (entry->second.dirty)
+    {
+      BuildBatches(entry->second);
+    }
+
+    const std::vector<Batch>& batches = entry->second.batches;
+    if (batches.empty())
+    {
+      return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vertex),
+                    reinterpret_cast<const GLvoid*>(offsetof(Vertex, x)));
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex),
+                      reinterpret_cast<const GLvoid*>(offsetof(Vertex, u)));
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex),
+                   reinterpret_cast<const GLvoid*>(offsetof(Vertex, color)));
+
+    for (size_t i = 0; i < batches.size(); i++)
+    {
+      const Batch& batch = batches[i];
+
+      const double* matrix = NULL;
+      if (batch.transform != 0)
+      {
+        std::map<TransformId, Transform>::const_iterator transform = transforms_.find(batch.transform);
+        if (transform == transforms_.end())
+        {
+          continue;
+        }
+        matrix = transform->second.matrix;
+      }
+
+      if (batch.style.primitive == POINTS)
+      {
+        glPointSize(batch.style.size);
+      }
+      else if (batch.style.primitive != TRIANGLES)
+      {
+        glLineWidth(batch.style.size);
+      }
+
+      if (batch.style.texture != 0)
+      {
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, batch.style.texture);
+      }
+
+      if (matrix != NULL)
+      {
+        glPushMatrix();
+        glMultMatrixd(matrix);
+      }
+
+      glMultiDrawArrays(
+          ToGlMode(batch.style.primitive),
+          &batch.first[0],
+          &batch.count[0],
+          static_cast<GLsizei>(batch.first.size()));
+
+      if (matrix != NULL)
+      {
+        glPopMatrix();
+      }
+
+      if (batch.style.texture != 0)
+      {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_TEXTURE_2D);
+      }
+    }
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  void GeometryRenderer::DeleteBuffers()
+  {
+    if (vertex_buffer_ != 0)
+    {
+      glDeleteBuffers(1, &vertex_buffer_);
+      vertex_buffer_ = 0;
+    }
+    buffer_capacity_ = 0;
+
+    // Everything is uploaded again if the renderer is used after this.
+    std::map<GeometryId, Geometry>::const_iterator it;
+    for (it = geometry_.begin(); it != geometry_.end(); ++it)
+    {
+      upload_.insert(it->first);
+    }
+  }
+
+  void GeometryRenderer::Changed(const Geometry& geometry)
+  {
+    owners_[geometry.owner].dirty = true;
+  }
+
+  void GeometryRenderer::UploadVertices()
+  {
+    if (used_ <= buffer_capacity_ && unused_ <= used_ / 2)
+    {
+      if (upload_.empty())
+      {
+        return;
+      }
+
+      glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+      std::set<GeometryId>::const_iterator it;
+      for (it = upload_.begin(); it != upload_.end(); ++it)
+      {
+        const Geometry& geometry = geometry_[*it];
+        if (!geometry.vertices.empty())
+        {
+          glBufferSubData(
+              GL_ARRAY_BUFFER,
+              geometry.first * sizeof(Vertex),
+              geometry.vertices.size() * sizeof(Vertex),
+              &geometry.vertices[0]);
+        }
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      upload_.clear();
+      return;
+    }
+
+    // The buffer is full or fragmented; pack every geometry's range
+    // together and upload everything into a new buffer.
+    size_t next = 0;
+    std::map<GeometryId, Geometry>::iterator it;
+    for (it = geometry_.begin(); it != geometry_.end(); ++it)
+    {
+      it->second.first = next;
+      next += it->second.capacity;
+    }
+    used_ = next;
+    unused_ = 0;
+    buffer_capacity_ = std::max(static_cast<size_t>(1024), used_ * 2);
+
+    if (vertex_buffer_ == 0)
+    {
+      glGenBuffers(1, &vertex_buffer_);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, buffer_capacity_ * sizeof(Vertex), NULL, GL_DYNAMIC_DRAW);
+    for (it = geometry_.begin(); it != geometry_.end(); ++it)
+    {
+      const Geometry& geometry = it->second;
+      if (!geometry.vertices.empty())
+      {
+        glBufferSubData(
+            GL_ARRAY_BUFFER,
+            geometry.first * sizeof(Vertex),
+            geometry.vertices.size() * sizeof(Vertex),
+            &geometry.vertices[0]);
+      }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    upload_.clear();
+
+    std::map<const MapvizPlugin*, Owner>::iterator owner;
+    for (owner = owners_.begin(); owner != owners_.end(); ++owner)
+    {
+      owner->second.dirty = true;
+    }
+  }
+
+  void GeometryRenderer::BuildBatches(Owner& owner)
+  {
+    std::vector<const Geometry*> visible;
+    std::set<GeometryId>::const_iterator id;
+    for (id = owner.geometry.begin(); id != owner.geometry.end(); ++id)
+    {
+      const Geometry& geometry = geometry_[*id];
+      if (geometry.visible && !geometry.vertices.empty())
+      {
+        visible.push_back(&geometry);
+      }
+    }
+
+    // Sort by render state so that geometry sharing a state is adjacent.
+    std::stable_sort(visible.begin(), visible.end(),
+        [](const Geometry* a, const Geometry* b)
+        {
+          if (a->transform != b->transform)
+            return a->transform < b->transform;
+          if (a->style.texture != b->style.texture)
+            return a->style.texture < b->style.texture;
+          if (a->style.primitive != b->style.primitive)
+            return a->style.primitive < b->style.primitive;
+          return a->style.size < b->style.size;
+        });
+
+    owner.batches.clear();
+    for (size_t i = 0; i < visible.size(); i++)
+    {
+      const Geometry& geometry = *visible[i];
+
+      bool merge = !owner.batches.empty();
+      if (merge)
+      {
+        const Batch& last = owner.batches.back();
+        merge = last.transform == geometry.transform &&
+            last.style.texture == geometry.style.texture &&
+            last.style.primitive == geometry.style.primitive &&
+            last.style.size == geometry.style.size;
+      }
+
+      if (!merge)
+      {
+        owner.batches.push_back(Batch());
+        owner.batches.back().style = geometry.style;
+        owner.batches.back().transform = geometry.transform;
+      }
+
+      owner.batches.back().first.push_back(static_cast<GLint>(geometry.first));
+      owner.batches.back().count.push_back(static_cast<GLsizei>(geometry.vertices.size()));
+    }
+
+    owner.dirty = false;
+  }
+}  // namespace mapviz
@@ -36,11 +36,22 @@
 
 // C++ standard libraries
 #include <cmath>
+
+// QT libraries
+#include <QCoreApplication>
+
 #include <swri_math_util/constants.h>
 
 namespace mapviz
 {
 
+// Frames are still drawn this often when nothing reports a change, so that
+// plugins whose output depends only on time (e.g. expiring markers) catch up.
+const double IDLE_REDRAW_INTERVAL = 1.0;
+
+// Fraction of the view's diagonal added on every side of a cached static
+// layer so that small pans can reuse it.
+const double STATIC_LAYER_MARGIN = 0.25;
 
 bool compare_plugins(MapvizPluginPtr a, MapvizPluginPtr b)
 {
@@ -57,6 +68,9 @@ MapCanvas::MapCanvas(QWidget* parent) :
   fix_orientation_(false),
   rotate_90_(false),
   enable_antialiasing_(true),
+  cache_static_layers_(false),
+  redraw_requested_(true),
+  checked_tf_generation_(0),
   mouse_button_(Qt::NoButton),
   mouse_pressed_(false),
   mouse_x_(0),
@@ -72,6 +86,7 @@ MapCanvas::MapCanvas(QWidget* parent) :
   view_center_x_(0),
   view_center_y_(0),
   view_scale_(1),
+  view_rotation_(0),
   view_left_(-25),
   view_right_(25),
   view_top_(10),
@@ -79,30 +94,44 @@ MapCanvas::MapCanvas(QWidget* parent) :
   scene_left_(-10),
   scene_right_(10),
   scene_top_(10),
-  scene_bottom_(-10)
+  scene_bottom_(-10),
+  view_transform_valid_(false)
 {
   ROS_INFO("View scale: %f meters/pixel", view_scale_);
   setMouseTracking(true);
 
   transform_.setIdentity();
+  transform_cache_ = boost::make_shared<TransformCache>();
+  geometry_renderer_ = boost::make_shared<GeometryRenderer>();
 
-  QObject::connect(&frame_rate_timer_, SIGNAL(timeout()), this, SLOT(update()));
+  QObject::connect(&frame_rate_timer_, SIGNAL(timeout()), this, SLOT(ScheduleFrame()));
   setFrameRate(50.0);
   frame_rate_timer_.start();
   setFocusPolicy(Qt::StrongFocus);
+
+  // Filter input for the whole application rather than just the canvas, so
+  // that plugins' event filters on the canvas can't hide it.
+  QCoreApplication::instance()->installEventFilter(this);
 }
 
 MapCanvas::~MapCanvas()
 {
+  makeCurrent();
+  static_layers_.clear();
+  geometry_renderer_->DeleteBuffers();
+
   if(pixel_buffer_size_ != 0)
   {
     glDeleteBuffersARB(2, pixel_buffer_ids_);
   }
 }
 
-void MapCanvas::InitializeTf(boost::shared_ptr<tf::TransformListener> tf)
+void MapCanvas::InitializeTf(
+    boost::shared_ptr<tf::TransformListener> tf,
+    swri_transform_util::TransformManagerPtr tf_manager)
 {
   tf_ = tf;
+  transform_cache_->Initialize(tf, tf_manager);
 }
 
 void MapCanvas::InitializePixelBuffers()
@@ -223,6 +252,13 @@ void MapCanvas::paintEvent(QPaintEvent* event)
     CaptureFrame();
   }
 
+  // Transforms looked up by the previous frame may be stale now.
+  transform_cache_->NewFrame();
+
+  redraw_requested_ = false;
+  checked_tf_generation_ = transform_cache_->FrameTfGeneration();
+  last_frame_time_ = ros::WallTime::now();
+
   QPainter p(this);
   p.setRenderHints(QPainter::Antialiasing |
                    QPainter::TextAntialiasing |
@@ -241,6 +277,7 @@ void MapCanvas::paintEvent(QPaintEvent* event)
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   TransformTarget(&p);
+  draw_context_.SetView(view_center_x_, view_center_y_, view_scale_, view_rotation_, width(), height());
 
   // Draw test pattern
   glLineWidth(3);
@@ -256,14 +293,36 @@ void MapCanvas::paintEvent(QPaintEvent* event)
   glVertex2f(0, 20);
   glEnd();
 
-  std::list<MapvizPluginPtr>::iterator it;
-  for (it = plugins_.begin(); it != plugins_.end(); ++it)
+  size_t layer_count = 0;
+  std::list<MapvizPluginPtr>::iterator it = plugins_.begin();
+  while (it != plugins_.end())
   {
+    if (cache_static_layers_ && (*it)->SupportsLayerCaching() && !(*it)->SupportsPainting())
+    {
+      std::list<MapvizPluginPtr>::iterator end = it;
+      while (end != plugins_.end() &&
+             (*end)->SupportsLayerCaching() && !(*end)->SupportsPainting())
+      {
+        ++end;
+      }
+
+      if (layer_count == static_layers_.size())
+      {
+        static_layers_.push_back(StaticLayer());
+      }
+      DrawStaticLayer(static_layers_[layer_count], it, end);
+      layer_count++;
+
+      it = end;
+      continue;
+    }
+
     // Before we let a plugin do any drawing, push all matrices and attributes.
     // This helps to ensure that plugins can't accidentally mess something up
     // for the next plugin.
     pushGlMatrices();
 
+    (*it)->SetDrawContext(draw_context_);
     (*it)->DrawPlugin(view_center_x_, view_center_y_, view_scale_);
 
     if ((*it)->SupportsPainting())
@@ -275,13 +334,156 @@ void MapCanvas::paintEvent(QPaintEvent* event)
     }
 
     popGlMatrices();
+    ++it;
   }
+  // Release the layers of runs that no longer exist
+  static_layers_.resize(layer_count);
 
   glMatrixMode(GL_MODELVIEW);
   glPopMatrix();
   p.endNativePainting();
 }
 
+void MapCanvas::DrawStaticLayer(
+    StaticLayer& layer,
+    std::list<MapvizPluginPtr>::iterator begin,
+    std::list<MapvizPluginPtr>::iterator end)
+{
+  std::list<MapvizPluginPtr>::iterator it;
+  for (it = begin; it != end; ++it)
+  {
+    (*it)->TransformPlugin();
+  }
+
+  // The layer can be reused while it was drawn at the current scale from the
+  // same data and still covers the view at any rotation.
+  bool valid = layer.fbo && layer.scale == view_scale_;
+  if (valid)
+  {
+    const double radius = 0.5 * std::sqrt(width() * width() + height() * height()) * view_scale_;
+    valid = std::fabs(view_center_x_ - layer.center_x) + radius <= layer.half_size &&
+            std::fabs(view_center_y_ - layer.center_y) + radius <= layer.half_size;
+  }
+
+  size_t count = 0;
+  for (it = begin; valid && it != end; ++it, ++count)
+  {
+    valid = count < layer.contents.size() &&
+            layer.contents[count].first == *it &&
+            layer.contents[count].second == (*it)->DataGeneration();
+  }
+  valid = valid && count == layer.contents.size();
+
+  if (!valid && !RenderStaticLayer(layer, begin, end))
+  {
+    // The layer can't be cached, so draw the plugins directly.
+    for (it = begin; it != end; ++it)
+    {
+      pushGlMatrices();
+      (*it)->SetDrawContext(draw_context_);
+      (*it)->DrawPlugin(view_center_x_, view_center_y_, view_scale_);
+      popGlMatrices();
+    }
+    return;
+  }
+
+  // The layer holds colors premultiplied by alpha.
+  pushGlMatrices();
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, layer.fbo->texture());
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+  const double left = layer.center_x - layer.half_size;
+  const double right = layer.center_x + layer.half_size;
+  const double bottom = layer.center_y - layer.half_size;
+  const double top = layer.center_y + layer.half_size;
+  glBegin(GL_QUADS);
+  glTexCoord2f(0.0f, 0.0f); glVertex2d(left, bottom);
+  glTexCoord2f(1.0f, 0.0f); glVertex2d(right, bottom);
+  glTexCoord2f(1.0f, 1.0f); glVertex2d(right, top);
+  glTexCoord2f(0.0f, 1.0f); glVertex2d(left, top);
+  glEnd();
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDisable(GL_TEXTURE_2D);
+  popGlMatrices();
+}
+
+bool MapCanvas::RenderStaticLayer(
+    StaticLayer& layer,
+    std::list<MapvizPluginPtr>::iterator begin,
+    std::list<MapvizPluginPtr>::iterator end)
+{
+  // A square around the view's circumscribed circle, plus a margin, with one
+  // texel per screen pixel.
+  const double diagonal = std::sqrt(width() * width() + height() * height());
+  const int size = static_cast<int>(std::ceil(diagonal * (1.0 + 2.0 * STATIC_LAYER_MARGIN)));
+
+  GLint max_size = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+  if (size > max_size || !QGLFramebufferObject::hasOpenGLFramebufferObjects())
+  {
+    layer.fbo.reset();
+    layer.contents.clear();
+    return false;
+  }
+
+  if (!layer.fbo || layer.fbo->width() != size)
+  {
+    layer.fbo = boost::make_shared<QGLFramebufferObject>(size, size);
+    glBindTexture(GL_TEXTURE_2D, layer.fbo->texture());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  layer.center_x = view_center_x_;
+  layer.center_y = view_center_y_;
+  layer.half_size = 0.5 * size * view_scale_;
+  layer.scale = view_scale_;
+  layer.contents.clear();
+
+  layer.fbo->bind();
+  pushGlMatrices();
+
+  glViewport(0, 0, size, size);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(layer.center_x - layer.half_size, layer.center_x + layer.half_size,
+          layer.center_y - layer.half_size, layer.center_y + layer.half_size,
+          -0.5f, 0.5f);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  DrawContext context;
+  context.SetView(layer.center_x, layer.center_y, view_scale_, 0.0, size, size);
+
+  std::list<MapvizPluginPtr>::iterator it;
+  for (it = begin; it != end; ++it)
+  {
+    // Plugins that can't draw everything yet (e.g. tiles still loading) call
+    // DataChanged() while drawing, so the layer is drawn again next frame.
+    layer.contents.push_back(std::make_pair(*it, (*it)->DataGeneration()));
+
+    pushGlMatrices();
+    // Keep the alpha channel correct while blending into a transparent
+    // target; this leaves the colors premultiplied.
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    (*it)->SetDrawContext(context);
+    (*it)->DrawPlugin(layer.center_x, layer.center_y, view_scale_);
+    popGlMatrices();
+  }
+
+  popGlMatrices();
+  layer.fbo->release();
+
+  return true;
+}
+
 void MapCanvas::pushGlMatrices()
 {
   glMatrixMode(GL_TEXTURE);
@@ -315,6 +517,7 @@ void MapCanvas::Zoom(float factor)
 {
   view_scale_ *= std::pow(1.1, factor);
   UpdateView();
+  RequestRedraw();
 }
 
 void MapCanvas::mousePressEvent(QMouseEvent* e)
@@ -416,6 +619,7 @@ void MapCanvas::SetFixedFrame(const std::string& frame)
   {
     (*it)->SetTargetFrame(frame);
   }
+  RequestRedraw();
 }
 
 void MapCanvas::SetTargetFrame(const std::string& frame)
@@ -426,20 +630,29 @@ void MapCanvas::SetTargetFrame(const std::string& frame)
   drag_y_ = 0;
 
   target_frame_ = frame;
+  RequestRedraw();
 }
 
 void MapCanvas::ToggleFixOrientation(bool on)
 {
   fix_orientation_ = on;
+  RequestRedraw();
 }
 
 void MapCanvas::ToggleRotate90(bool on)
 {
   rotate_90_ = on;
+  RequestRedraw();
 }
 
 void MapCanvas::ToggleEnableAntialiasing(bool on)
 {
+  // The layers and vertex buffers belong to the GL context that setFormat()
+  // replaces.
+  makeCurrent();
+  static_layers_.clear();
+  geometry_renderer_->DeleteBuffers();
+
   enable_antialiasing_ = on;
   QGLFormat format;
   format.setSwapInterval(1);
@@ -457,17 +670,32 @@ void MapCanvas::ToggleUseLatestTransforms(bool on)
   }
 }
 
+void MapCanvas::ToggleCacheStaticLayers(bool on)
+{
+  cache_static_layers_ = on;
+  if (!cache_static_layers_)
+  {
+    makeCurrent();
+    static_layers_.clear();
+  }
+  RequestRedraw();
+}
+
 void MapCanvas::AddPlugin(MapvizPluginPtr plugin, int order)
 {
+  plugin->SetTransformCache(transform_cache_);
+  plugin->SetGeometryRenderer(geometry_renderer_);
   plugins_.push_back(plugin);
+  RequestRedraw();
 }
 
 void MapCanvas::RemovePlugin(MapvizPluginPtr plugin)
 {
   
   plugin->Shutdown(); 
+  geometry_renderer_->RemoveAll(plugin.get());
   plugins_.remove(plugin);
-  
+  RequestRedraw();
 }
 
 void MapCanvas::TransformTarget(QPainter* painter)
@@ -481,6 +709,8 @@ void MapCanvas::TransformTarget(QPainter* painter)
 
   view_center_x_ = -offset_x_ - drag_x_;
   view_center_y_ = -offset_y_ - drag_y_;
+  view_rotation_ = 0;
+  view_transform_valid_ = false;
 
   if (!tf_ || fixed_frame_.empty() || target_frame_.empty() || target_frame_ == "<none>")
   {
@@ -495,6 +725,8 @@ void MapCanvas::TransformTarget(QPainter* painter)
   try
   {
     tf_->lookupTransform(fixed_frame_, target_frame_, ros::Time(0), transform_);
+    view_transform_ = transform_;
+    view_transform_valid_ = true;
 
     // If the viewer orientation is fixed don't rotate the center point.
     if (fix_orientation_)
@@ -513,6 +745,7 @@ void MapCanvas::TransformTarget(QPainter* painter)
 
     glRotatef(-yaw * 57.2957795, 0, 0, 1);
     qtransform_ = qtransform_.rotateRadians(yaw);
+    view_rotation_ = yaw;
 
     glTranslatef(-transform_.getOrigin().getX(), -transform_.getOrigin().getY(), 0);
     qtransform_ = qtransform_.translate(-transform_.getOrigin().getX(), transform_.getOrigin().getY());
@@ -591,6 +824,7 @@ void MapCanvas::ResetLocation()
 void MapCanvas::ReorderDisplays()
 {
   plugins_.sort(compare_plugins);
+  RequestRedraw();
 }
 
 void MapCanvas::Recenter()
@@ -616,4 +850,108 @@ double MapCanvas::frameRate() const
 {
   return 1000.0 / frame_rate_timer_.interval();
 }
+
+void MapCanvas::RequestRedraw()
+{
+  redraw_requested_ = true;
+}
+
+void MapCanvas::ScheduleFrame()
+{
+  bool redraw = redraw_requested_;
+
+  // New tf data only needs a new frame if it moves the view or changes a
+  // transform that a plugin has looked up.
+  uint64_t tf_generation = transform_cache_->TfGeneration();
+  if (!redraw && tf_generation != checked_tf_generation_)
+  {
+    if (ViewTransformChanged() || transform_cache_->LookupsChanged())
+    {
+      redraw = true;
+    }
+    else
+    {
+      checked_tf_generation_ = tf_generation;
+    }
+  }
+
+  // Every plugin's request is taken so none carries over to the next frame.
+  std::list<MapvizPluginPtr>::iterator it;
+  for (it = plugins_.begin(); it != plugins_.end(); ++it)
+  {
+    if ((*it)->TakeRedrawRequest())
+    {
+      redraw = true;
+    }
+  }
+
+  if (ros::WallTime::now() - last_frame_time_ > ros::WallDuration(IDLE_REDRAW_INTERVAL))
+  {
+    redraw = true;
+  }
+
+  if (redraw)
+  {
+    update();
+  }
+}
+
+bool MapCanvas::ViewTransformChanged()
+{
+  if (!tf_ || fixed_frame_.empty() || target_frame_.empty() || target_frame_ == "<none>")
+  {
+    return false;
+  }
+
+  tf::StampedTransform transform;
+  try
+  {
+    tf_->lookupTransform(fixed_frame_, target_frame_, ros::Time(0), transform);
+  }
+  catch (const tf::TransformException&)
+  {
+    return view_transform_valid_;
+  }
+
+  return !view_transform_valid_ || !(transform == view_transform_);
+}
+
+bool MapCanvas::eventFilter(QObject* object, QEvent* event)
+{
+  if (object == this)
+  {
+    // Input on the canvas moves the view or is handled by a plugin's tool.
+    switch (event->type())
+    {
+      case QEvent::MouseButtonPress:
+      case QEvent::MouseButtonRelease:
+      case QEvent::MouseButtonDblClick:
+      case QEvent::MouseMove:
+      case QEvent::Wheel:
+      case QEvent::KeyPress:
+      case QEvent::KeyRelease:
+        RequestRedraw();
+        break;
+      default:
+        break;
+    }
+  }
+  else
+  {
+    // Most plugin settings don't request a redraw themselves, so a click or
+    // key press in another widget draws one frame.  Moving the mouse over
+    // other widgets doesn't.
+    switch (event->type())
+    {
+      case QEvent::MouseButtonRelease:
+      case QEvent::KeyRelease:
+        RequestRedraw();
+        break;
+      default:
+        break;
+    }
+  }
+
+  return false;
+}
 }  // namespace mapviz
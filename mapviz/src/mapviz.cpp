@@ -273,7 +273,7 @@ void Mapviz::Initialize()
       ROS_INFO("Found mapviz plugin: %s", plugins[i].c_str());
     }
 
-    canvas_->InitializeTf(tf_);
+    canvas_->InitializeTf(tf_, tf_manager_);
     canvas_->SetFixedFrame(ui_.fixedframe->currentText().toStdString());
     canvas_->SetTargetFrame(ui_.targetframe->currentText().toStdString());
 
@@ -308,6 +308,10 @@ void Mapviz::Initialize()
     bool auto_save;
     priv.param("auto_save_backup", auto_save, true);
 
+    double max_frame_rate;
+    priv.param("max_frame_rate", max_frame_rate, 50.0);
+    canvas_->setFrameRate(max_frame_rate);
+
     Open(config);
 
     UpdateFrames();
@@ -597,6 +601,13 @@ void Mapviz::Open(const std::string& filename)
       ui_.actionEnable_Antialiasing->setChecked(enable_antialiasing);
     }
 
+    if (swri_yaml_util::FindValue(doc, "cache_static_layers"))
+    {
+      bool cache_static_layers = false;
+      doc["cache_static_layers"] >> cache_static_layers;
+      ui_.actionCache_Static_Layers->setChecked(cache_static_layers);
+    }
+
     if (swri_yaml_util::FindValue(doc, "show_displays"))
     {
       bool show_displays = false;
@@ -782,6 +793,7 @@ void Mapviz::Save(const std::string& filename)
   out << YAML::Key << "fix_orientation" << YAML::Value << ui_.actionFix_Orientation->isChecked();
   out << YAML::Key << "rotate_90" << YAML::Value << ui_.actionRotate_90->isChecked();
   out << YAML::Key << "enable_antialiasing" << YAML::Value << ui_.actionEnable_Antialiasing->isChecked();
+  out << YAML::Key << "cache_static_layers" << YAML::Value << ui_.actionCache_Static_Layers->isChecked();
   out << YAML::Key << "show_displays" << YAML::Value << ui_.actionConfig_Dock->isChecked();
   out << YAML::Key << "show_status_bar" << YAML::Value << ui_.actionShow_Status_Bar->isChecked();
   out << YAML::Key << "show_capture_tools" << YAML::Value << ui_.actionShow_Capture_Tools->isChecked();
@@ -1286,6 +1298,11 @@ void Mapviz::ToggleEnableAntialiasing(bool on)
   canvas_->ToggleEnableAntialiasing(on);
 }
 
+void Mapviz::ToggleCacheStaticLayers(bool on)
+{
+  canvas_->ToggleCacheStaticLayers(on);
+}
+
 void Mapviz::ToggleConfigPanel(bool on)
 {
   if (on)
@@ -0,0 +1,92 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <mapviz/text_cache.h>
+
+// QT libraries
+#include <QTransform>
+
+namespace mapviz
+{
+  TextCache::TextCache(std::size_t max_size) :
+    max_size_(max_size),
+    frame_(0)
+  {
+  }
+
+  void TextCache::SetFont(const QFont& font)
+  {
+    if (font != font_)
+    {
+      font_ = font;
+      entries_.clear();
+    }
+  }
+
+  QStaticText TextCache::Get(const QString& text)
+  {
+    auto iter = entries_.find(text);
+    if (iter == entries_.end())
+    {
+      Entry entry;
+      entry.text.setText(text);
+      entry.text.setTextFormat(Qt::PlainText);
+      entry.text.setPerformanceHint(QStaticText::AggressiveCaching);
+      entry.text.prepare(QTransform(), font_);
+      iter = entries_.insert(text, entry);
+    }
+
+    iter->last_used = frame_;
+    return iter->text;
+  }
+
+  void TextCache::Trim()
+  {
+    if (static_cast<std::size_t>(entries_.size()) > max_size_)
+    {
+      for (auto iter = entries_.begin(); iter != entries_.end();)
+      {
+        if (iter->last_used != frame_)
+        {
+          iter = entries_.erase(iter);
+        }
+        else
+        {
+          ++iter;
+        }
+      }
+    }
+    frame_++;
+  }
+
+  void TextCache::Clear()
+  {
+    entries_.clear();
+  }
+}
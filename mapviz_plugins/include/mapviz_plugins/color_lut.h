@@ -0,0 +1,147 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_COLOR_LUT_H_
+#define MAPVIZ_PLUGINS_COLOR_LUT_H_
+
+// C++ standard libraries
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// QT libraries
+#include <QColor>
+
+namespace mapviz_plugins
+{
+  /**
+   * Colormap of the point plugins' color transformers as a table of packed
+   * RGBA8 colors, so that coloring a point is a multiply, a clamp and a
+   * load instead of building a QColor.
+   *
+   * Colors are packed in memory order (R, G, B, A), as uploaded with
+   * GL_UNSIGNED_BYTE color arrays.
+   */
+  class ColorLut
+  {
+  public:
+    enum { SIZE = 1024 };
+
+    ColorLut() : table_(SIZE, 0), flat_(0) {}
+
+    /**
+     * Fills the table.  Only needs to be called when the colormap changes.
+     */
+    void Build(bool use_rainbow, const QColor& min_color, const QColor& max_color, double alpha)
+    {
+      const int a = static_cast<int>(alpha * 255.0);
+      for (size_t i = 0; i < SIZE; i++)
+      {
+        const double val = static_cast<double>(i) / (SIZE - 1);
+        if (use_rainbow)
+        {
+          // Hue Interpolation
+          const QColor color = QColor::fromHsl(static_cast<int>(val * 255), 255, 127, 255);
+          table_[i] = Pack(color.red(), color.green(), color.blue(), a);
+        }
+        else
+        {
+          // RGB Interpolation
+          table_[i] = Pack(
+              static_cast<int>(val * max_color.red() + ((1.0 - val) * min_color.red())),
+              static_cast<int>(val * max_color.green() + ((1.0 - val) * min_color.green())),
+              static_cast<int>(val * max_color.blue() + ((1.0 - val) * min_color.blue())),
+              a);
+        }
+      }
+      flat_ = Pack(min_color.red(), min_color.green(), min_color.blue(), a);
+    }
+
+    /**
+     * Colors values normalized to [min_value, max_value].  If max_value
+     * isn't greater than min_value, values are only clamped to [0, 1].
+     */
+    void Map(const float* values,
+             size_t count,
+             double min_value,
+             double max_value,
+             uint32_t* colors) const
+    {
+      float offset = 0.0f;
+      float scale = static_cast<float>(SIZE - 1);
+      if (max_value > min_value)
+      {
+        offset = static_cast<float>(min_value);
+        scale = static_cast<float>((SIZE - 1) / (max_value - min_value));
+      }
+
+      // Indices are computed into the output in a branch-free loop of their
+      // own so that the compiler can vectorize it; only the table loads that
+      // replace them are scalar.
+      const float max_index = static_cast<float>(SIZE - 1);
+      for (size_t i = 0; i < count; i++)
+      {
+        float index = (values[i] - offset) * scale;
+        // NaN fails both comparisons and ends up at 0
+        index = index > 0.0f ? index : 0.0f;
+        index = index < max_index ? index : max_index;
+        colors[i] = static_cast<uint32_t>(index + 0.5f);
+      }
+
+      for (size_t i = 0; i < count; i++)
+      {
+        colors[i] = table_[colors[i]];
+      }
+    }
+
+    /**
+     * The min color, for points that are drawn in a flat color.
+     */
+    uint32_t Flat() const { return flat_; }
+
+    static uint32_t Pack(int r, int g, int b, int a)
+    {
+      const uint8_t bytes[4] = {
+          static_cast<uint8_t>(r),
+          static_cast<uint8_t>(g),
+          static_cast<uint8_t>(b),
+          static_cast<uint8_t>(a)};
+      uint32_t packed;
+      std::memcpy(&packed, bytes, sizeof(packed));
+      return packed;
+    }
+
+  private:
+    std::vector<uint32_t> table_;
+    uint32_t flat_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_COLOR_LUT_H_
@@ -0,0 +1,92 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_COLORMAP_SHADER_H_
+#define MAPVIZ_PLUGINS_COLORMAP_SHADER_H_
+
+#include <boost/scoped_ptr.hpp>
+
+// QT libraries
+#include <QColor>
+#include <QGLContext>
+#include <QGLShaderProgram>
+
+namespace mapviz_plugins
+{
+  /**
+   * Colors points on the GPU from one scalar value per point, the same way
+   * the point plugins' color transformers do on the CPU: the value is
+   * normalized to [min, max] and either interpolated between two colors or
+   * mapped to a hue.
+   *
+   * Positions come from the fixed-function vertex array; the value is the
+   * generic attribute at ValueLocation().  Since the colormap is a set of
+   * uniforms, changing it doesn't touch the per-point data.
+   */
+  class ColormapShader
+  {
+  public:
+    ColormapShader();
+
+    /**
+     * Compiles the shader for a GL context.
+     * @return False if the context doesn't support it; the caller should
+     *         color points on the CPU instead.
+     */
+    bool Initialize(const QGLContext* context);
+
+    bool IsValid() const { return program_.get() != NULL; }
+
+    /**
+     * Binds the shader and sets the colormap.  If max_value isn't greater
+     * than min_value, values are only clamped to [0, 1].
+     */
+    void Bind(double min_value,
+              double max_value,
+              bool use_rainbow,
+              const QColor& min_color,
+              const QColor& max_color,
+              double alpha);
+
+    /**
+     * Draws the points that follow in min_color, ignoring their values.
+     */
+    void SetFlat(bool flat);
+
+    void Release();
+
+    int ValueLocation() const { return value_location_; }
+
+  private:
+    boost::scoped_ptr<QGLShaderProgram> program_;
+    int value_location_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_COLORMAP_SHADER_H_
@@ -0,0 +1,111 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_EXPIRY_QUEUE_H_
+#define MAPVIZ_PLUGINS_EXPIRY_QUEUE_H_
+
+// C++ standard libraries
+#include <queue>
+#include <utility>
+#include <vector>
+
+// ROS libraries
+#include <ros/time.h>
+
+namespace mapviz_plugins
+{
+  /**
+   * Keeps track of when items with a limited lifetime expire, so that
+   * finding the expired ones doesn't require looking at every item.
+   *
+   * Entries are never removed early.  When an item is replaced or deleted
+   * its old entry stays in the queue and is popped at its original time;
+   * callers should compare the popped time against the item's current
+   * expiration time and ignore entries that don't match.
+   */
+  template <typename Key>
+  class ExpiryQueue
+  {
+  public:
+    /**
+     * Adds an item.  Items that never expire are not stored.
+     */
+    void Push(const Key& key, const ros::Time& expire_time)
+    {
+      if (expire_time != ros::TIME_MAX)
+      {
+        heap_.push(Entry(expire_time, key));
+      }
+    }
+
+    /**
+     * Removes the earliest entry if it expired at or before now.
+     * @return False if no entries have expired.
+     */
+    bool PopExpired(const ros::Time& now, Key& key, ros::Time& expire_time)
+    {
+      if (heap_.empty() || heap_.top().first > now)
+      {
+        return false;
+      }
+
+      expire_time = heap_.top().first;
+      key = heap_.top().second;
+      heap_.pop();
+      return true;
+    }
+
+    void Clear()
+    {
+      heap_ = Heap();
+    }
+
+    /**
+     * The number of entries, including ones that are out of date.
+     */
+    size_t Size() const { return heap_.size(); }
+
+  private:
+    typedef std::pair<ros::Time, Key> Entry;
+
+    struct Later
+    {
+      bool operator()(const Entry& a, const Entry& b) const
+      {
+        return a.first > b.first;
+      }
+    };
+
+    typedef std::priority_queue<Entry, std::vector<Entry>, Later> Heap;
+
+    Heap heap_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_EXPIRY_QUEUE_H_
@@ -73,6 +73,11 @@ namespace mapviz_plugins
 
     QWidget* GetConfigWidget(QWidget* parent);
 
+    bool SupportsLayerCaching()
+    {
+      return true;
+    }
+
   protected:
     void PrintError(const std::string& message);
     void PrintInfo(const std::string& message);
@@ -87,6 +92,7 @@ namespace mapviz_plugins
     void SetSize(double size);
     void SetRows(int rows);
     void SetColumns(int columns);
+    void ColorEdited();
     void DrawIcon();
 
   private:
@@ -108,15 +114,20 @@ namespace mapviz_plugins
     std::list<tf::Point> left_points_;
     std::list<tf::Point> right_points_;
 
-    std::list<tf::Point> transformed_top_points_;
-    std::list<tf::Point> transformed_bottom_points_;
-    std::list<tf::Point> transformed_left_points_;
-    std::list<tf::Point> transformed_right_points_;
-
     swri_transform_util::Transform transform_;
+    // Whether transform_ can be expressed as a matrix
+    bool rigid_;
+
+    // The grid lines are kept in the source frame by the canvas's geometry
+    // renderer, which applies transform_ when drawing them.  If transform_
+    // isn't rigid, the lines are transformed on the CPU instead.
+    mapviz::GeometryRenderer::GeometryId geometry_;
+    mapviz::GeometryRenderer::TransformId geometry_transform_;
+    bool geometry_dirty_;
 
     void RecalculateGrid();
-    void Transform(std::list<tf::Point>& src, std::list<tf::Point>& dst);
+    void UpdateGeometry();
+    mapviz::GeometryRenderer::Vertex MakeVertex(const tf::Point& point, const QColor& color) const;
   };
 }
 
@@ -0,0 +1,136 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_LABEL_GRID_H_
+#define MAPVIZ_PLUGINS_LABEL_GRID_H_
+
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// QT libraries
+#include <QRect>
+#include <QRectF>
+
+namespace mapviz_plugins
+{
+  /**
+   * Coarse occupancy grid over the screen for placing labels without
+   * overlap.  Labels are placed one at a time, in priority order; a label
+   * is rejected if any cell it touches already holds another label.
+   *
+   * Cells are claimed whole, so labels closer together than a cell are
+   * treated as overlapping, which also leaves some space between them.
+   */
+  class LabelGrid
+  {
+  public:
+    explicit LabelGrid(int cell_size = 8) :
+      cell_size_(std::max(1, cell_size)),
+      origin_x_(0),
+      origin_y_(0),
+      columns_(0),
+      rows_(0)
+    {
+    }
+
+    /**
+     * Empties the grid and sizes it to cover a region of the screen.
+     */
+    void Reset(const QRect& region)
+    {
+      origin_x_ = region.left();
+      origin_y_ = region.top();
+      columns_ = std::max(1, (region.width() + cell_size_ - 1) / cell_size_);
+      rows_ = std::max(1, (region.height() + cell_size_ - 1) / cell_size_);
+      cells_.assign(static_cast<size_t>(columns_) * rows_, 0);
+    }
+
+    /**
+     * Claims the cells covered by a label.
+     * @return False, without claiming anything, if the label overlaps one
+     *         that was already placed.
+     */
+    bool Place(const QRectF& rect)
+    {
+      if (cells_.empty())
+      {
+        return true;
+      }
+
+      const int min_x = Column(rect.left());
+      const int max_x = Column(rect.right());
+      const int min_y = Row(rect.top());
+      const int max_y = Row(rect.bottom());
+
+      for (int y = min_y; y <= max_y; y++)
+      {
+        for (int x = min_x; x <= max_x; x++)
+        {
+          if (cells_[y * columns_ + x])
+          {
+            return false;
+          }
+        }
+      }
+
+      for (int y = min_y; y <= max_y; y++)
+      {
+        std::fill(cells_.begin() + y * columns_ + min_x,
+                  cells_.begin() + y * columns_ + max_x + 1,
+                  1);
+      }
+      return true;
+    }
+
+  private:
+    int Column(double x) const
+    {
+      const int column = static_cast<int>(std::floor((x - origin_x_) / cell_size_));
+      return std::max(0, std::min(columns_ - 1, column));
+    }
+
+    int Row(double y) const
+    {
+      const int row = static_cast<int>(std::floor((y - origin_y_) / cell_size_));
+      return std::max(0, std::min(rows_ - 1, row));
+    }
+
+    int cell_size_;
+    int origin_x_;
+    int origin_y_;
+    int columns_;
+    int rows_;
+    std::vector<uint8_t> cells_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_LABEL_GRID_H_
@@ -35,13 +35,21 @@
 #include <deque>
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
+
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz_plugins/color_lut.h>
+#include <mapviz_plugins/colormap_shader.h>
+#include <mapviz_plugins/scan_handoff.h>
 
 // QT libraries
 #include <QGLWidget>
 #include <QColor>
+#include <QMutex>
 
 // ROS libraries
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
 #include <sensor_msgs/LaserScan.h>
 
 // QT autogenerated files
@@ -100,13 +108,13 @@ namespace mapviz_plugins
       void UpdateColors();    
       void DrawIcon();
       void ResetTransformedScans();
+      void BackgroundDecodeChanged(int check_state);
+      void ConsumeDecodedScans();
 
     private:
       struct StampedPoint
       {
         tf::Point point;
-        tf::Point transformed_point;
-        QColor color;
         float range;
         float intensity;
       };
@@ -117,12 +125,77 @@ namespace mapviz_plugins
         QColor color;
         std::vector<StampedPoint> points;
         std::string source_frame_;
+        // Frame the transformed points are in
+        std::string target_frame_;
         bool transformed;
+        // Transform from the source frame to the target frame and, when it
+        // is rigid, the same transform as a matrix the points are drawn with
+        swri_transform_util::Transform transform;
+        tf::Transform matrix;
+        bool rigid;
         bool has_intensity;
+        // DecodeSettings::generation the points were colored with
+        uint64_t settings_generation;
+        // Color transformer gl_value was computed for, or -1 if it needs to
+        // be computed again
+        int value_transformer;
+        // True if the points are drawn in the flat color
+        bool flat;
+
+        // Packed x, y of each point, the value the color transformer maps to
+        // a color for each point and, when colors are computed on the CPU,
+        // packed RGBA of each point, as they are laid out in the vertex
+        // buffers.  Points are in the source frame if the transform is rigid
+        // and in the target frame otherwise.
+        std::vector<float> gl_point;
+        std::vector<float> gl_value;
+        std::vector<uint32_t> gl_color;
+        // Extent of the points in the source frame and in the target frame
+        mapviz::BoundingBox local_bounds;
+        mapviz::BoundingBox bounds;
+        // Slot of the vertex buffers this scan is stored in
+        size_t vbo_slot;
+        bool point_dirty;
+        bool value_dirty;
+        bool color_dirty;
+      };
+
+      /**
+       * A copy of the GUI state that coloring a scan depends on, so that
+       * scans can be decoded and colored off the GUI thread.
+       */
+      struct DecodeSettings
+      {
+        std::string target_frame;
+        int color_transformer;
+        QColor min_color;
+        QColor max_color;
+        bool use_rainbow;
+        double min_value;
+        double max_value;
+        double alpha;
+        // The colormap above, for coloring points on the CPU
+        ColorLut color_lut;
+        // Whether points are colored by colormap_shader_ instead of on the CPU
+        bool use_shader;
+        uint64_t generation;
       };
 
+      void Subscribe();
       void laserScanCallback(const sensor_msgs::LaserScanConstPtr& scan);
-      QColor CalculateColor(const StampedPoint& point, bool has_intensity);
+      void backgroundLaserScanCallback(const sensor_msgs::LaserScanConstPtr& scan);
+      void DecodeScan(const sensor_msgs::LaserScanConstPtr& msg, Scan& scan);
+      void TransformScan(Scan& scan, const swri_transform_util::Transform& transform);
+      void ColorScan(Scan& scan, const DecodeSettings& settings) const;
+      float PointValue(const Scan& scan, const StampedPoint& point, int color_transformer) const;
+      void ProcessScan(Scan& scan);
+      void StoreScan(Scan& scan);
+      void UpdateDecodeSettings();
+      DecodeSettings CopySettings();
+      void RecolorScans();
+      void UpdateVertexBuffers();
+      void DeleteVertexBuffers();
+      void DrawScans(double scale);
       void updatePreComputedTriginometic(const sensor_msgs::LaserScanConstPtr& msg);
 
       Ui::laserscan_config ui_;
@@ -148,6 +221,38 @@ namespace mapviz_plugins
       float  prev_angle_min_;
       float  prev_increment_;
       bool GetScanTransform(const Scan &scan, swri_transform_util::Transform& transform);
+
+      // All scans share one set of vertex buffers, divided into slots of
+      // slot_capacity_ points, so they are bound once per frame.
+      GLuint point_vbo_;
+      GLuint value_vbo_;
+      GLuint color_vbo_;
+      size_t num_slots_;
+      size_t slot_capacity_;
+      size_t next_vbo_slot_;
+
+      // Points are colored on the GPU when shaders are supported, so that
+      // changing the colormap doesn't touch the points
+      bool shader_checked_;
+      bool use_shader_;
+      ColormapShader colormap_shader_;
+
+      // Guards settings_, which is read by the background decode thread
+      QMutex settings_mutex_;
+      DecodeSettings settings_;
+
+      // Scan that the next message is decoded into on the GUI thread; after
+      // it is stored this holds the evicted scan so its memory is reused.
+      Scan spare_scan_;
+
+      // When enabled, messages are delivered on decode_queue_ and decoded by
+      // decode_spinner_'s thread, then passed to the GUI thread via handoff_.
+      // The precomputed trigonometry is only used by whichever thread is
+      // decoding.
+      bool background_decode_;
+      ros::CallbackQueue decode_queue_;
+      boost::scoped_ptr<ros::AsyncSpinner> decode_spinner_;
+      ScanHandoff<Scan> handoff_;
   };
 }
 
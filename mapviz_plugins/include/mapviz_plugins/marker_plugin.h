@@ -31,14 +31,26 @@
 #define MAPVIZ_PLUGINS_MARKER_PLUGIN_H_
 
 // C++ standard libraries
+#include <map>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/spatial_index.h>
+#include <mapviz/text_cache.h>
+#include <mapviz_plugins/expiry_queue.h>
+#include <mapviz_plugins/label_grid.h>
 
 // QT libraries
+#include <QGLShaderProgram>
 #include <QGLWidget>
 #include <QListWidgetItem>
+#include <QString>
 
 // ROS libraries
 #include <tf/transform_datatypes.h>
@@ -107,6 +119,9 @@ namespace mapviz_plugins
     void SelectTopic();
     void TopicEdited();
     void ClearHistory();
+    void Hover(double x, double y, double scale);
+    void NamespaceChanged(QListWidgetItem* item);
+    void DeclutterToggled(bool checked);
 
   private:
     struct Color
@@ -114,39 +129,99 @@ namespace mapviz_plugins
       float r, g, b, a;
     };
 
+    // Points are stored in the marker's source frame, with the marker's
+    // pose already applied
     struct StampedPoint
     {
       tf::Point point;
-      tf::Quaternion orientation;
-
-      tf::Point transformed_point;
 
       tf::Point arrow_point;
-      tf::Point transformed_arrow_point;
-      tf::Point transformed_arrow_left;
-      tf::Point transformed_arrow_right;
+      tf::Point arrow_left;
+      tf::Point arrow_right;
 
       Color color;
     };
 
+    // One element of a CUBE_LIST, SPHERE_LIST or POINTS marker that is drawn
+    // with instancing.  The center keeps z for the same reason vertices do.
+    struct Instance
+    {
+      float x;
+      float y;
+      float z;
+      float size_x;
+      float size_y;
+      uint8_t color[4];
+    };
+
+    // Frame and stamp of the transform a marker is drawn with
+    typedef std::pair<std::string, ros::Time> TransformKey;
+
+    // The transform of every marker with the same frame and stamp, which is
+    // only looked up once and lets the geometry renderer draw those markers
+    // together
+    struct SharedTransform
+    {
+      TransformKey key;
+      bool valid;
+      swri_transform_util::Transform transform;
+      // The transform in the geometry renderer, or 0
+      mapviz::GeometryRenderer::TransformId id;
+      // Number of markers using the transform
+      uint32_t users;
+    };
+
     struct MarkerData
     {
       ros::Time stamp;
       ros::Time expire_time;
 
+      // Hash of the message fields the marker was decoded from, for
+      // recognizing a marker that was published again unchanged
+      std::size_t content_hash;
+      // Value of marker_generation_ when the marker was last added
+      uint32_t generation;
+
+      // Index of the marker's namespace in namespace_visible_
+      uint32_t ns_id;
+
       int display_type;
       Color color;
 
       std::vector<StampedPoint> points;
-      std::string text;
+      QString text;
 
       float scale_x;
       float scale_y;
       float scale_z;
 
       std::string source_frame;
-      swri_transform_util::Transform local_transform;
-      
+
+      // Transform from the source frame to the target frame.  Rigid
+      // transforms are applied by the GPU as a matrix; anything else (such
+      // as from WGS84) is applied to the vertices.  Circles and squares are
+      // drawn in the target frame's XY plane, so markers made of them also
+      // count as not rigid when their frame is tilted.
+      swri_transform_util::Transform transform;
+      tf::Transform matrix;
+      bool rigid;
+      // Entry in shared_transforms_ the transform comes from
+      SharedTransform* shared_transform;
+
+      // Extent of the points in the source frame, including the size of
+      // circles and squares and the range of z, and in the target frame
+      mapviz::BoundingBox local_bounds;
+      float min_z;
+      float max_z;
+      mapviz::BoundingBox bounds;
+
+      // The marker's geometry in the canvas's geometry renderer, or the
+      // buffer of its elements if it is drawn with instancing
+      mapviz::GeometryRenderer::GeometryId geometry;
+      GLuint instance_buffer;
+      GLsizei instance_count;
+      bool geometry_dirty;
+
       bool transformed;
     };
 
@@ -160,13 +235,77 @@ namespace mapviz_plugins
     bool has_message_;
 
     std::unordered_map<MarkerId, MarkerData, MarkerIdHash> markers_;
-    std::unordered_map<std::string, bool, MarkerNsHash> marker_visible_;
+    std::map<TransformKey, SharedTransform> shared_transforms_;
+    // Every namespace seen so far gets a small id, which indexes a
+    // visibility flag kept in sync with the namespace list
+    std::unordered_map<std::string, uint32_t, MarkerNsHash> namespace_ids_;
+    std::vector<bool> namespace_visible_;
+
+    // Bounds of every transformed marker, for finding the ones in a region
+    mapviz::SpatialIndex<MarkerId, MarkerIdHash> marker_index_;
+    // Expiration times of the markers that have a lifetime
+    ExpiryQueue<MarkerId> expiry_queue_;
+    // Markers whose geometry needs to be rebuilt before the next frame
+    std::vector<MarkerId> dirty_markers_;
+    // Scratch space for region queries and building geometry
+    std::vector<MarkerId> queried_markers_;
+    std::vector<mapviz::GeometryRenderer::Vertex> vertices_;
+    std::vector<Instance> instances_;
+
+    // List markers are drawn by instancing a unit square, circle or point
+    // when the GL supports it
+    bool instancing_checked_;
+    bool use_instancing_;
+    boost::scoped_ptr<QGLShaderProgram> instance_program_;
+    GLuint shape_buffer_;
+    std::unordered_set<MarkerId, MarkerIdHash> instanced_markers_;
+    // Buffers of removed markers, deleted the next time the GL context is
+    // current
+    std::vector<GLuint> unused_buffers_;
+
+    // Incremented by every DELETEALL in a marker array; markers that aren't
+    // added again by the end of the array are removed
+    uint32_t marker_generation_;
+    // Number of recent ADDs, and how many of them were unchanged markers
+    uint32_t marker_updates_;
+    uint32_t marker_hits_;
+
+    // The marker under the mouse, if any
+    MarkerId hover_marker_;
+    bool hovering_marker_;
+
+    // Laid out text of the TEXT_VIEW_FACING markers
+    mapviz::TextCache text_cache_;
+    // Screen space taken by the labels drawn so far in a frame
+    LabelGrid label_grid_;
 
     void handleMessage(const topic_tools::ShapeShifter::ConstPtr& msg);
     void handleMarker(const visualization_msgs::Marker &marker);
     void handleMarkerArray(const visualization_msgs::MarkerArray &markers);
-    void transformArrow(MarkerData& markerData,
-                        const swri_transform_util::Transform& transform);
+    void refreshMarker(const MarkerId& id, MarkerData& markerData, const visualization_msgs::Marker& marker);
+    void setLifetime(const MarkerId& id, MarkerData& markerData, const ros::Duration& lifetime);
+    const SharedTransform& acquireTransform(MarkerData& markerData);
+    void releaseTransform(MarkerData& markerData);
+    void lookupTransform(SharedTransform& shared);
+    void setTransform(const MarkerId& id, MarkerData& markerData, const swri_transform_util::Transform& transform);
+    void updateLocalBounds(MarkerData& markerData);
+    void updateBounds(const MarkerId& id, MarkerData& markerData);
+    void markGeometryDirty(const MarkerId& id, MarkerData& markerData);
+    void updateGeometry(const MarkerId& id, MarkerData& markerData);
+    bool initInstancing();
+    void updateInstances(const MarkerId& id, MarkerData& markerData);
+    void releaseInstances(const MarkerId& id, MarkerData& markerData);
+    void drawInstances();
+    void updateGeometryTransform(MarkerData& markerData);
+    void removeMarker(const MarkerId& id);
+    void clearMarkers();
+    void removeExpiredMarkers(const ros::Time& now);
+    void queryMarkers(const mapviz::BoundingBox& region);
+    bool pickMarker(double x, double y, double tolerance, MarkerId& id);
+    void printStatus();
+
+    static mapviz::GeometryRenderer::Vertex makeVertex(const tf::Point& point, const Color& color);
+    static std::size_t HashMarker(const visualization_msgs::Marker& marker);
   };
 }
 
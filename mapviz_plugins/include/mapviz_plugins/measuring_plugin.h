@@ -37,6 +37,7 @@
 
 // Mapviz libraries
 #include <mapviz/map_canvas.h>
+#include <mapviz/text_cache.h>
 
 // QT autogenerated files
 #include "ui_measuring_config.h"
@@ -106,12 +107,14 @@ namespace mapviz_plugins
       qint64 max_ms_;
       qreal max_distance_;
       std::vector<double> measurements_;
+      mapviz::TextCache text_cache_;
   };
 
   struct MeasurementBox
   {
     QRectF rect;
     QString string;
+    QStaticText text;
   };
 
 }
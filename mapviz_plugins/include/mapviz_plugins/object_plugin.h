@@ -32,8 +32,10 @@
 
 // C++ standard libraries
 #include <string>
+#include <vector>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz/spatial_index.h>
 
 // QT libraries
 #include <QGLWidget>
@@ -112,7 +114,10 @@ namespace mapviz_plugins
 
       std::string source_frame;
       swri_transform_util::Transform local_transform;
-      
+
+      // Extent of the transformed polygon
+      mapviz::BoundingBox bounds;
+
       bool transformed;
     };
 
@@ -128,9 +133,16 @@ namespace mapviz_plugins
 
     std::vector<ObjectData> objects_;
 
+    // Bounds of the transformed objects, keyed by their index in objects_
+    mapviz::SpatialIndex<size_t> object_index_;
+    // Scratch space for region queries
+    std::vector<size_t> queried_objects_;
+
     void handleMessage(const topic_tools::ShapeShifter::ConstPtr& msg);
     void handleTrack(const marti_nav_msgs::TrackedObject& obj);
     void handleObstacle(const marti_nav_msgs::Obstacle& obj, const std_msgs::Header& header);
+    void updateBounds(size_t index);
+    void queryObjects(const mapviz::BoundingBox& region);
   };
 }
 
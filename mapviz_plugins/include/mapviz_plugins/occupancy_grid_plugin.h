@@ -33,6 +33,9 @@
 // C++ standard libraries
 #include <string>
 #include <list>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
 
 #include <mapviz/mapviz_plugin.h>
 
@@ -41,6 +44,8 @@
 #include <QObject>
 #include <QWidget>
 #include <QTimer>
+#include <QRect>
+#include <QGLShaderProgram>
 
 // ROS libraries
 #include <ros/ros.h>
@@ -77,6 +82,11 @@ namespace mapviz_plugins
 
     QWidget* GetConfigWidget(QWidget* parent);
 
+    bool SupportsLayerCaching()
+    {
+      return true;
+    }
+
   protected:
     void PrintError(const std::string& message);
     void PrintInfo(const std::string& message);
@@ -88,12 +98,26 @@ namespace mapviz_plugins
     void TopicGridEdited();
     void upgradeCheckBoxToggled(bool);
     void colorSchemeUpdated(const QString &);
+    void alphaChanged(double);
 
     void DrawIcon();
 
     void FrameChanged(std::string);
 
   private:
+    /**
+     * A texture holding up to TILE_SIZE x TILE_SIZE cells of the grid.
+     */
+    struct Tile
+    {
+      // Cells of the grid this tile covers
+      QRect cells;
+      // Cells that changed since they were last uploaded
+      QRect dirty;
+      GLuint texture_id;
+      bool allocated;
+    };
+
     Ui::occupancy_grid_config ui_;
     QWidget* config_widget_;
 
@@ -105,20 +129,40 @@ namespace mapviz_plugins
     bool transformed_;
     swri_transform_util::Transform transform_;
 
-    GLuint texture_id_;
+    // Tiles covering the grid in row-major order, tiles_x_ per row
+    std::vector<Tile> tiles_;
+    int tiles_x_;
+    int grid_width_;
+    int grid_height_;
+    // Textures of a previous tile layout, deleted on the next Draw()
+    std::vector<GLuint> stale_textures_;
+
+    // When shaders are available the raw cell values are uploaded as a
+    // one-byte texture and colored through a 256 entry palette texture.
+    // Otherwise they are expanded into color_buffer_ on the CPU.
+    GLuint palette_texture_id_;
+    bool palette_dirty_;
+    bool shader_checked_;
+    bool use_shader_;
+    boost::scoped_ptr<QGLShaderProgram> palette_program_;
     
     QPointF map_origin_;
-    float texture_x_, texture_y_;
+    // Cell values and colors, grid_width_ cells per row
     std::vector<uchar> raw_buffer_;
     std::vector<uchar> color_buffer_;
-    int32_t texture_size_;
 
     Palette map_palette_;
     Palette costmap_palette_;
 
     void Callback(const nav_msgs::OccupancyGridConstPtr& msg);
     void CallbackUpdate(const map_msgs::OccupancyGridUpdateConstPtr& msg);
-    void updateTexture();
+    const Palette& currentPalette() const;
+    bool initPaletteShader();
+    void updatePalette();
+    void updateColorBuffer(const QRect& rect);
+    void markDirty(const QRect& rect);
+    void updateTile(Tile& tile);
+    void updateTextures();
 
   };
 }
@@ -36,7 +36,12 @@
 #include <vector>
 #include <map>
 
+#include <boost/scoped_ptr.hpp>
+
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz_plugins/color_lut.h>
+#include <mapviz_plugins/colormap_shader.h>
+#include <mapviz_plugins/scan_handoff.h>
 
 // QT libraries
 #include <QGLWidget>
@@ -44,6 +49,8 @@
 #include <QMutex>
 
 // ROS libraries
+#include <ros/callback_queue.h>
+#include <ros/spinner.h>
 #include <sensor_msgs/PointCloud2.h>
 
 // QT autogenerated files
@@ -108,33 +115,119 @@ namespace mapviz_plugins
     void ResetTransformedPointClouds();
     void ClearPointClouds();
     void SetSubscription(bool subscribe);
+    void BackgroundDecodeChanged(int check_state);
+    void ConsumeDecodedScans();
 
   private:
-    struct StampedPoint
-    {
-      tf::Point point;
-      std::vector<float> features;
-    };
-
+    /**
+     * Points are stored as packed x, y, z in the source frame, exactly as
+     * they are drawn, plus a single array for the field selected by the
+     * color transformer.  Other fields in the message are never decoded.
+     */
     struct Scan
     {
       ros::Time stamp;
       QColor color;
-      std::vector<StampedPoint> points;
+      // Values of feature_name for each point; empty when coloring is flat.
+      std::vector<float> feature;
+      std::string feature_name;
       std::string source_frame;
+      // Frame the points are transformed into
+      std::string target_frame;
       bool transformed;
-      std::map<std::string, FieldInfo> new_features;
+      // The transform to target_frame as a matrix the points are drawn
+      // with, if it is rigid; otherwise the points are drawn from
+      // gl_transformed.
+      tf::Transform matrix;
+      bool rigid;
+      std::vector<sensor_msgs::PointField> fields;
+      // DecodeSettings::generation this scan was decoded and colored with
+      uint64_t settings_generation;
 
       std::vector<float> gl_point;
-      std::vector<uint8_t> gl_color;
+      // Packed x, y, z of each point in the target frame
+      std::vector<float> gl_transformed;
+      // Packed RGBA of each point.  Only filled when colors are computed on
+      // the CPU; otherwise feature is uploaded and colored by the shader.
+      std::vector<uint32_t> gl_color;
+      // Extent of the points in the source frame, including their z range,
+      // and in the target frame
+      mapviz::BoundingBox local_bounds;
+      float min_z;
+      float max_z;
+      mapviz::BoundingBox bounds;
+      // Slot in vbo_ring_ holding this scan's GPU copy, and whether the
+      // CPU-side arrays have changed since they were last uploaded.
+      size_t vbo_slot;
+      bool point_dirty;
+      bool value_dirty;
+      bool color_dirty;
+    };
+
+    /**
+     * A pair of GL buffers that are reused by successive scans.  The
+     * capacities track how many bytes have been allocated on the GPU so
+     * that uploads only reallocate when a scan outgrows its slot.
+     */
+    struct VertexBufferSlot
+    {
       GLuint point_vbo;
+      GLuint value_vbo;
       GLuint color_vbo;
+      size_t point_capacity;
+      size_t value_capacity;
+      size_t color_capacity;
+    };
+
+    /**
+     * A copy of the GUI state that decoding, transforming and coloring a
+     * scan depend on.  Scans are processed from this copy rather than from
+     * the widgets so that they can be processed off the GUI thread.
+     */
+    struct DecodeSettings
+    {
+      std::string target_frame;
+      std::string active_feature;
+      QColor min_color;
+      QColor max_color;
+      bool use_rainbow;
+      bool unpack_rgb;
+      bool use_automaxmin;
+      double min_value;
+      double max_value;
+      double alpha;
+      // The colormap above, for coloring points on the CPU
+      ColorLut color_lut;
+      // Range of the active feature seen so far, used by use_automaxmin
+      float auto_min;
+      float auto_max;
+      // Whether the shader is available to color points
+      bool use_shader;
+      // Incremented whenever anything above except the auto range changes
+      uint64_t generation;
     };
 
     float PointFeature(const uint8_t*, const FieldInfo&);
     void PointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& scan);
-    QColor CalculateColor(const StampedPoint& point);
+    void BackgroundPointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& scan);
+    bool DecodeScan(const sensor_msgs::PointCloud2ConstPtr& msg,
+                    Scan& scan,
+                    DecodeSettings& settings,
+                    std::string& error);
+    void TransformScan(Scan& scan, const swri_transform_util::Transform& transform);
+    void ColorScan(Scan& scan, const DecodeSettings& settings) const;
+    static bool ShaderColors(const DecodeSettings& settings);
+    void ProcessScan(Scan& scan);
+    void StoreScan(Scan& scan);
+    void UpdateFieldList(const std::vector<sensor_msgs::PointField>& fields);
+    void UpdateDecodeSettings();
+    DecodeSettings CopySettings();
+    void ResetAutoRange();
+    void RecolorScans();
     void UpdateMinMaxWidgets();
+    void ResizeVertexBufferRing();
+    void UploadScan(Scan& scan, bool shader_colors);
+    void DeleteVertexBuffers();
 
     Ui::PointCloud2_config ui_;
     QWidget* config_widget_;
@@ -145,21 +238,45 @@ namespace mapviz_plugins
     double min_value_;
     size_t point_size_;
     size_t buffer_size_;
-    bool new_topic_;
     bool has_message_;
     size_t num_of_feats_;
     bool need_new_list_;
     std::string saved_color_transformer_;
-    bool need_minmax_;
-    std::vector<double> max_;
-    std::vector<double> min_;
+    // Name of the field selected by the color transformer, if any
+    std::string active_feature_;
     // Use a list instead of a deque for scans to facilitate removing
     // timed-out scans in the middle of the list in case I ever re-implement
     // decay time (evenator)
     std::deque<Scan> scans_;
     ros::Subscriber pc2_sub_;
 
+    // One slot per buffered scan; new scans take the slot of the scan they
+    // evict, so steady-state operation never allocates GPU memory.
+    std::vector<VertexBufferSlot> vbo_ring_;
+    size_t next_vbo_slot_;
+
+    // Points are colored on the GPU when shaders are supported, so that
+    // changing the colormap or the auto range doesn't touch the points
+    bool shader_checked_;
+    bool use_shader_;
+    ColormapShader colormap_shader_;
+
     QMutex scan_mutex_;
+
+    // Guards settings_, which is read by the background decode thread
+    QMutex settings_mutex_;
+    DecodeSettings settings_;
+
+    // Scan that the next message is decoded into on the GUI thread; after
+    // it is stored this holds the evicted scan so its memory is reused.
+    Scan spare_scan_;
+
+    // When enabled, messages are delivered on decode_queue_ and decoded by
+    // decode_spinner_'s thread, then passed to the GUI thread via handoff_.
+    bool background_decode_;
+    ros::CallbackQueue decode_queue_;
+    boost::scoped_ptr<ros::AsyncSpinner> decode_spinner_;
+    ScanHandoff<Scan> handoff_;
   };
 }
 
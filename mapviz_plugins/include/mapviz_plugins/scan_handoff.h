@@ -0,0 +1,139 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef MAPVIZ_PLUGINS_SCAN_HANDOFF_H_
+#define MAPVIZ_PLUGINS_SCAN_HANDOFF_H_
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+namespace mapviz_plugins
+{
+  /**
+   * Passes scans that were decoded on a background thread to the GUI thread
+   * without locking.
+   *
+   * There must be exactly one producer (the decode thread) and one consumer
+   * (the GUI thread).  Scans travel through two single-producer,
+   * single-consumer queues: decoded scans go to the consumer, and scans the
+   * consumer no longer needs travel back so that the producer can reuse
+   * their memory instead of allocating for every message.  A scan the
+   * producer doesn't publish is kept for its next Acquire().
+   */
+  template <typename T>
+  class ScanHandoff
+  {
+  public:
+    static const size_t CAPACITY = 8;
+
+    ScanHandoff() : spare_(NULL) {}
+
+    ~ScanHandoff()
+    {
+      delete spare_;
+      T* scan;
+      while (decoded_.pop(scan))
+      {
+        delete scan;
+      }
+      while (recycled_.pop(scan))
+      {
+        delete scan;
+      }
+    }
+
+    /**
+     * Called by the producer to get a scan to decode into.
+     */
+    T* Acquire()
+    {
+      T* scan = spare_;
+      if (scan != NULL)
+      {
+        spare_ = NULL;
+        return scan;
+      }
+      if (recycled_.pop(scan))
+      {
+        return scan;
+      }
+      return new T();
+    }
+
+    /**
+     * Called by the producer to hand a decoded scan to the consumer.  If the
+     * consumer has fallen behind, the scan is dropped and false is returned.
+     */
+    bool Publish(T* scan)
+    {
+      if (decoded_.push(scan))
+      {
+        return true;
+      }
+      Release(scan);
+      return false;
+    }
+
+    /**
+     * Called by the producer to give back a scan it acquired but won't
+     * publish, such as one that failed to decode.
+     */
+    void Release(T* scan)
+    {
+      delete spare_;
+      spare_ = scan;
+    }
+
+    /**
+     * Called by the consumer to take the next decoded scan, if any.
+     */
+    bool Consume(T*& scan)
+    {
+      return decoded_.pop(scan);
+    }
+
+    /**
+     * Called by the consumer to return a scan to the producer for reuse.
+     */
+    void Recycle(T* scan)
+    {
+      if (!recycled_.push(scan))
+      {
+        delete scan;
+      }
+    }
+
+  private:
+    boost::lockfree::spsc_queue<T*, boost::lockfree::capacity<CAPACITY> > decoded_;
+    boost::lockfree::spsc_queue<T*, boost::lockfree::capacity<CAPACITY> > recycled_;
+    // Only used by the producer
+    T* spare_;
+  };
+}
+
+#endif  // MAPVIZ_PLUGINS_SCAN_HANDOFF_H_
@@ -34,8 +34,10 @@
 #include <string>
 #include <list>
 #include <map>
+#include <utility>
 
 #include <mapviz/mapviz_plugin.h>
+#include <mapviz_plugins/expiry_queue.h>
 
 // QT libraries
 #include <QGLWidget>
@@ -135,9 +137,14 @@ namespace mapviz_plugins
 
     std::map<std::string, std::map<int, MarkerData> > markers_;
 
+    // Expiration times of the markers that have a lifetime, keyed by
+    // namespace and id
+    ExpiryQueue<std::pair<std::string, int> > expiry_queue_;
+
     bool is_marker_array_;
 
     void ProcessMarker(const marti_visualization_msgs::TexturedMarker& marker);
+    void RemoveExpiredMarkers(const ros::Time& now);
 
     void MarkerCallback(const marti_visualization_msgs::TexturedMarkerConstPtr marker);
 
@@ -0,0 +1,141 @@
+// *****************************************************************************
+//
+// Copyright (c) 2026, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// *****************************************************************************
+
+#include <mapviz_plugins/colormap_shader.h>
+
+// ROS libraries
+#include <ros/console.h>
+
+namespace mapviz_plugins
+{
+  ColormapShader::ColormapShader() :
+    value_location_(-1)
+  {
+  }
+
+  bool ColormapShader::Initialize(const QGLContext* context)
+  {
+    program_.reset();
+    value_location_ = -1;
+
+    if (!QGLShaderProgram::hasOpenGLShaderPrograms(context))
+    {
+      return false;
+    }
+
+    // Matches ColorLut::Build(): the hue is the normalized value * 255
+    // degrees, at full saturation and half lightness.
+    const char* vertex_shader =
+        "attribute float value;\n"
+        "uniform float min_value;\n"
+        "uniform float max_value;\n"
+        "uniform bool use_rainbow;\n"
+        "uniform bool flat_color;\n"
+        "uniform vec4 min_color;\n"
+        "uniform vec4 max_color;\n"
+        "uniform float alpha;\n"
+        "void main()\n"
+        "{\n"
+        "  vec3 color = min_color.rgb;\n"
+        "  if (!flat_color)\n"
+        "  {\n"
+        "    float t = value;\n"
+        "    if (max_value > min_value)\n"
+        "    {\n"
+        "      t = (value - min_value) / (max_value - min_value);\n"
+        "    }\n"
+        "    t = clamp(t, 0.0, 1.0);\n"
+        "    if (use_rainbow)\n"
+        "    {\n"
+        "      float hue = t * 255.0 / 60.0;\n"
+        "      vec3 rgb = clamp(vec3(abs(hue - 3.0) - 1.0,\n"
+        "                            2.0 - abs(hue - 2.0),\n"
+        "                            2.0 - abs(hue - 4.0)), 0.0, 1.0);\n"
+        "      float lightness = 127.0 / 255.0;\n"
+        "      float chroma = 1.0 - abs(2.0 * lightness - 1.0);\n"
+        "      color = (rgb - 0.5) * chroma + lightness;\n"
+        "    }\n"
+        "    else\n"
+        "    {\n"
+        "      color = mix(min_color.rgb, max_color.rgb, t);\n"
+        "    }\n"
+        "  }\n"
+        "  gl_FrontColor = vec4(color, alpha);\n"
+        "  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+        "}\n";
+    const char* fragment_shader =
+        "void main()\n"
+        "{\n"
+        "  gl_FragColor = gl_Color;\n"
+        "}\n";
+
+    program_.reset(new QGLShaderProgram(context));
+    // Keep the value off attribute 0, which some drivers alias to gl_Vertex.
+    program_->bindAttributeLocation("value", 1);
+    if (!program_->addShaderFromSourceCode(QGLShader::Vertex, vertex_shader) ||
+        !program_->addShaderFromSourceCode(QGLShader::Fragment, fragment_shader) ||
+        !program_->link())
+    {
+      ROS_WARN("Falling back to CPU point coloring: %s",
+               program_->log().toStdString().c_str());
+      program_.reset();
+      return false;
+    }
+
+    value_location_ = program_->attributeLocation("value");
+    return true;
+  }
+
+  void ColormapShader::Bind(double min_value,
+                            double max_value,
+                            bool use_rainbow,
+                            const QColor& min_color,
+                            const QColor& max_color,
+                            double alpha)
+  {
+    program_->bind();
+    program_->setUniformValue("min_value", static_cast<GLfloat>(min_value));
+    program_->setUniformValue("max_value", static_cast<GLfloat>(max_value));
+    program_->setUniformValue("use_rainbow", static_cast<GLint>(use_rainbow));
+    program_->setUniformValue("flat_color", static_cast<GLint>(false));
+    program_->setUniformValue("min_color", min_color);
+    program_->setUniformValue("max_color", max_color);
+    program_->setUniformValue("alpha", static_cast<GLfloat>(alpha));
+  }
+
+  void ColormapShader::SetFlat(bool flat)
+  {
+    program_->setUniformValue("flat_color", static_cast<GLint>(flat));
+  }
+
+  void ColormapShader::Release()
+  {
+    program_->release();
+  }
+}
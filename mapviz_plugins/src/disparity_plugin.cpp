@@ -233,6 +233,8 @@ namespace mapviz_plugins
 
   void DisparityPlugin::disparityCallback(const stereo_msgs::DisparityImageConstPtr& disparity)
   {
+    RequestRedraw();
+
     if (!has_message_)
     {
       initialized_ = true;
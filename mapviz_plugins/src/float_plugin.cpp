@@ -420,6 +420,8 @@ namespace mapviz_plugins
 
   void FloatPlugin::floatCallback(const topic_tools::ShapeShifter::ConstPtr& msg)
   {
+    RequestRedraw();
+
     double value = 0.0;
     if (is_instance<std_msgs::Float32>(msg))
     {
@@ -39,6 +39,9 @@
 #include <QGLWidget>
 #include <QPalette>
 
+// ROS libraries
+#include <swri_transform_util/frames.h>
+
 #include <mapviz/select_frame_dialog.h>
 
 // Declare plugin
@@ -54,7 +57,11 @@ namespace mapviz_plugins
     size_(1),
     rows_(1),
     columns_(1),
-    transformed_(false)
+    transformed_(false),
+    rigid_(true),
+    geometry_(0),
+    geometry_transform_(0),
+    geometry_dirty_(true)
   {
     ui_.setupUi(config_widget_);
 
@@ -78,7 +85,7 @@ namespace mapviz_plugins
     QObject::connect(ui_.size, SIGNAL(valueChanged(double)), this, SLOT(SetSize(double)));
     QObject::connect(ui_.rows, SIGNAL(valueChanged(int)), this, SLOT(SetRows(int)));
     QObject::connect(ui_.columns, SIGNAL(valueChanged(int)), this, SLOT(SetColumns(int)));
-    connect(ui_.color, SIGNAL(colorEdited(const QColor &)), this, SLOT(DrawIcon()));
+    connect(ui_.color, SIGNAL(colorEdited(const QColor &)), this, SLOT(ColorEdited()));
   }
 
   GridPlugin::~GridPlugin()
@@ -117,9 +124,18 @@ namespace mapviz_plugins
     }
   }
 
+  void GridPlugin::ColorEdited()
+  {
+    DrawIcon();
+    geometry_dirty_ = true;
+    DataChanged();
+  }
+
   void GridPlugin::SetAlpha(double alpha)
   {
     alpha_ = alpha;
+    geometry_dirty_ = true;
+    DataChanged();
   }
 
   void GridPlugin::SetX(double x)
@@ -209,103 +225,142 @@ namespace mapviz_plugins
 
   void GridPlugin::Draw(double x, double y, double scale)
   {
+    // The grid itself is drawn by the geometry renderer after this returns.
+    UpdateGeometry();
+
     if (transformed_)
     {
-      QColor color = ui_.color->color();
-      
-      glLineWidth(3);
-      glColor4d(color.redF(), color.greenF(), color.blueF(), alpha_);
-      glBegin(GL_LINES);
+      PrintInfo("OK");
+    }
+  }
 
-        std::list<tf::Point>::iterator transformed_left_it = transformed_left_points_.begin();
-        std::list<tf::Point>::iterator transformed_right_it = transformed_right_points_.begin();
-        for (; transformed_left_it != transformed_left_points_.end(); ++transformed_left_it)
-        {
-          glVertex2d(transformed_left_it->getX(), transformed_left_it->getY());
-          glVertex2d(transformed_right_it->getX(), transformed_right_it->getY());
+  void GridPlugin::UpdateGeometry()
+  {
+    if (!geometry_renderer_)
+    {
+      return;
+    }
 
-          ++transformed_right_it;
-        }
+    if (geometry_ == 0)
+    {
+      mapviz::GeometryRenderer::Style style;
+      style.primitive = mapviz::GeometryRenderer::LINES;
+      style.size = 3.0f;
+      geometry_ = geometry_renderer_->Create(this, style);
+      geometry_transform_ = geometry_renderer_->CreateTransform(this);
+      geometry_dirty_ = true;
+    }
 
-        std::list<tf::Point>::iterator transformed_top_it = transformed_top_points_.begin();
-        std::list<tf::Point>::iterator transformed_bottom_it = transformed_bottom_points_.begin();
-        for (; transformed_top_it != transformed_top_points_.end(); ++transformed_top_it)
-        {
-          glVertex2d(transformed_top_it->getX(), transformed_top_it->getY());
-          glVertex2d(transformed_bottom_it->getX(), transformed_bottom_it->getY());
+    if (geometry_dirty_)
+    {
+      QColor color = ui_.color->color();
 
-          ++transformed_bottom_it;
-        }
+      std::vector<mapviz::GeometryRenderer::Vertex> vertices;
+      vertices.reserve(2 * (left_points_.size() + top_points_.size()));
+
+      std::list<tf::Point>::const_iterator left_it = left_points_.begin();
+      std::list<tf::Point>::const_iterator right_it = right_points_.begin();
+      for (; left_it != left_points_.end() && right_it != right_points_.end(); ++left_it, ++right_it)
+      {
+        vertices.push_back(MakeVertex(*left_it, color));
+        vertices.push_back(MakeVertex(*right_it, color));
+      }
+
+      std::list<tf::Point>::const_iterator top_it = top_points_.begin();
+      std::list<tf::Point>::const_iterator bottom_it = bottom_points_.begin();
+      for (; top_it != top_points_.end() && bottom_it != bottom_points_.end(); ++top_it, ++bottom_it)
+      {
+        vertices.push_back(MakeVertex(*top_it, color));
+        vertices.push_back(MakeVertex(*bottom_it, color));
+      }
+
+      geometry_renderer_->SetVertices(geometry_, vertices);
+      geometry_dirty_ = false;
+    }
 
-      glEnd();
+    if (rigid_)
+    {
+      geometry_renderer_->UpdateTransform(
+          geometry_transform_,
+          tf::Transform(transform_.GetOrientation(), transform_.GetOrigin()));
+      geometry_renderer_->SetTransform(geometry_, geometry_transform_);
+    }
+    else
+    {
+      geometry_renderer_->ClearTransform(geometry_);
+    }
+    geometry_renderer_->SetVisible(geometry_, transformed_);
+  }
 
-      PrintInfo("OK");
+  mapviz::GeometryRenderer::Vertex GridPlugin::MakeVertex(const tf::Point& point, const QColor& color) const
+  {
+    if (rigid_)
+    {
+      return mapviz::GeometryRenderer::MakeVertex(point.getX(), point.getY(), color, alpha_);
     }
+
+    const tf::Point transformed = transform_ * point;
+    return mapviz::GeometryRenderer::MakeVertex(transformed.getX(), transformed.getY(), color, alpha_);
   }
 
   void GridPlugin::RecalculateGrid()
   {
     transformed_ = false;
+    geometry_dirty_ = true;
+    DataChanged();
 
     left_points_.clear();
     right_points_.clear();
     top_points_.clear();
     bottom_points_.clear();
 
-    transformed_left_points_.clear();
-    transformed_right_points_.clear();
-    transformed_top_points_.clear();
-    transformed_bottom_points_.clear();
-
     // Set top and bottom
     for (int c = 0; c <= columns_; c++)
     {
-      tf::Point top_point(top_left_.getX() + c * size_, top_left_.getY(), 0);
-      top_points_.push_back(top_point);
-      transformed_top_points_.push_back(transform_ * top_point);
-
-      tf::Point bottom_point(top_left_.getX() + c * size_, top_left_.getY() + size_ * rows_, 0);
-      bottom_points_.push_back(bottom_point);
-      transformed_bottom_points_.push_back(transform_ * bottom_point);
+      top_points_.push_back(tf::Point(top_left_.getX() + c * size_, top_left_.getY(), 0));
+      bottom_points_.push_back(tf::Point(top_left_.getX() + c * size_, top_left_.getY() + size_ * rows_, 0));
     }
 
     // Set left and right
     for (int r = 0; r <= rows_; r++)
     {
-      tf::Point left_point(top_left_.getX(), top_left_.getY() + r * size_, 0);
-      left_points_.push_back(left_point);
-      transformed_left_points_.push_back(transform_ * left_point);
-
-      tf::Point right_point(top_left_.getX() + size_ * columns_, top_left_.getY() + r * size_, 0);
-      right_points_.push_back(right_point);
-      transformed_right_points_.push_back(transform_ * right_point);
+      left_points_.push_back(tf::Point(top_left_.getX(), top_left_.getY() + r * size_, 0));
+      right_points_.push_back(tf::Point(top_left_.getX() + size_ * columns_, top_left_.getY() + r * size_, 0));
     }
   }
 
   void GridPlugin::Transform()
   {
+    bool was_transformed = transformed_;
     transformed_ = false;
 
-    if (GetTransform(ros::Time(), transform_))
+    swri_transform_util::Transform transform;
+    if (GetTransform(ros::Time(), transform))
     {
-      Transform(left_points_, transformed_left_points_);
-      Transform(right_points_, transformed_right_points_);
-      Transform(top_points_, transformed_top_points_);
-      Transform(bottom_points_, transformed_bottom_points_);
-
+      // Transforms to or from WGS84 can't be expressed as a matrix.
+      const bool rigid =
+          !swri_transform_util::FrameIdsEqual(source_frame_, swri_transform_util::_wgs84_frame) &&
+          !swri_transform_util::FrameIdsEqual(target_frame_, swri_transform_util::_wgs84_frame);
+
+      if (!was_transformed ||
+          rigid != rigid_ ||
+          transform.GetOrigin() != transform_.GetOrigin() ||
+          transform.GetOrientation() != transform_.GetOrientation())
+      {
+        // Only lines transformed on the CPU have to be rebuilt.
+        if (!rigid || !rigid_)
+        {
+          geometry_dirty_ = true;
+        }
+        DataChanged();
+      }
+      transform_ = transform;
+      rigid_ = rigid;
       transformed_ = true;
     }
-  }
-
-  void GridPlugin::Transform(std::list<tf::Point>& src, std::list<tf::Point>& dst)
-  {
-    std::list<tf::Point>::iterator points_it = src.begin();
-    std::list<tf::Point>::iterator transformed_it = dst.begin();
-    for (; points_it != src.end() && transformed_it != dst.end(); ++points_it)
+    else if (was_transformed)
     {
-      (*transformed_it) = transform_ * (*points_it);
-
-      ++transformed_it;
+      DataChanged();
     }
   }
 
@@ -311,6 +311,8 @@ namespace mapviz_plugins
 
   void ImagePlugin::imageCallback(const sensor_msgs::ImageConstPtr& image)
   {
+    RequestRedraw();
+
     if (!has_message_)
     {
       initialized_ = true;
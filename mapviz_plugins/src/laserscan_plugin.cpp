@@ -27,6 +27,7 @@
 //
 // *****************************************************************************
 
+#include <GL/glew.h>
 #include <mapviz_plugins/laserscan_plugin.h>
 
 // C++ standard libraries
@@ -37,6 +38,7 @@
 
 // Boost libraries
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 
 // QT libraries
 #include <QColorDialog>
@@ -48,6 +50,7 @@
 
 // ROS libraries
 #include <ros/master.h>
+#include <swri_transform_util/frames.h>
 #include <swri_transform_util/transform.h>
 #include <swri_yaml_util/yaml_util.h>
 
@@ -66,9 +69,19 @@ namespace mapviz_plugins
           min_value_(0.0),
           max_value_(100.0),
           point_size_(3),
+          buffer_size_(1),
           prev_ranges_size_(0),
           prev_angle_min_(0.0),
-          prev_increment_(0.0)
+          prev_increment_(0.0),
+          point_vbo_(0),
+          value_vbo_(0),
+          color_vbo_(0),
+          num_slots_(0),
+          slot_capacity_(0),
+          next_vbo_slot_(0),
+          shader_checked_(false),
+          use_shader_(false),
+          background_decode_(false)
   {
     ui_.setupUi(config_widget_);
 
@@ -94,6 +107,10 @@ namespace mapviz_plugins
     ui_.color_transformer->addItem(QString("Y Axis"), QVariant(4));
     ui_.color_transformer->addItem(QString("Z Axis"), QVariant(5));
 
+    settings_.generation = 0;
+    settings_.use_shader = false;
+    UpdateDecodeSettings();
+
     QObject::connect(ui_.selecttopic,
         SIGNAL(clicked()),
         this,
@@ -138,6 +155,10 @@ namespace mapviz_plugins
         SIGNAL(stateChanged(int)),
         this,
         SLOT(UseRainbowChanged(int)));
+    QObject::connect(ui_.background_decode,
+        SIGNAL(stateChanged(int)),
+        this,
+        SLOT(BackgroundDecodeChanged(int)));
 
     QObject::connect(ui_.max_color,
         SIGNAL(colorEdited(const QColor &)),
@@ -157,12 +178,17 @@ namespace mapviz_plugins
 
   LaserScanPlugin::~LaserScanPlugin()
   {
+    // Stop the decode thread before anything it uses is destroyed.
+    laserscan_sub_.shutdown();
+    decode_spinner_.reset();
+    DeleteVertexBuffers();
   }
 
   void LaserScanPlugin::ClearHistory()
   {
     ROS_DEBUG("LaserScan::ClearHistory()");
     scans_.clear();
+    next_vbo_slot_ = 0;
   }
 
   void LaserScanPlugin::DrawIcon()
@@ -201,73 +227,129 @@ namespace mapviz_plugins
 
   void LaserScanPlugin::ResetTransformedScans()
   {
+    UpdateDecodeSettings();
+
     for (Scan& scan: scans_)
     {
       scan.transformed = false;
     }
   }
 
-  QColor LaserScanPlugin::CalculateColor(const StampedPoint& point,
-      bool has_intensity)
+  void LaserScanPlugin::UpdateDecodeSettings()
+  {
+    QMutexLocker locker(&settings_mutex_);
+    settings_.target_frame = target_frame_;
+    settings_.color_transformer = ui_.color_transformer->currentIndex();
+    settings_.min_color = ui_.min_color->color();
+    settings_.max_color = ui_.max_color->color();
+    settings_.use_rainbow = ui_.use_rainbow->isChecked();
+    settings_.min_value = min_value_;
+    settings_.max_value = max_value_;
+    settings_.alpha = alpha_;
+    settings_.color_lut.Build(settings_.use_rainbow, settings_.min_color, settings_.max_color, alpha_);
+    settings_.use_shader = use_shader_;
+    settings_.generation++;
+  }
+
+  LaserScanPlugin::DecodeSettings LaserScanPlugin::CopySettings()
+  {
+    QMutexLocker locker(&settings_mutex_);
+    return settings_;
+  }
+
+  /**
+   * Returns the value of a point that the color transformer maps to a color.
+   */
+  float LaserScanPlugin::PointValue(const Scan& scan, const StampedPoint& point, int color_transformer) const
   {
-    double val;
-    int color_transformer = ui_.color_transformer->currentIndex();
     if (color_transformer == COLOR_RANGE)
     {
-      val = point.range;
+      return point.range;
     }
-    else if (color_transformer == COLOR_INTENSITY && has_intensity)
+    else if (color_transformer == COLOR_INTENSITY)
     {
-      val = point.intensity;
+      return point.intensity;
     }
     else if (color_transformer == COLOR_X)
     {
-      val = point.point.x();
+      return point.point.x();
     }
     else if (color_transformer == COLOR_Y)
     {
-      val = point.point.y();
+      return point.point.y();
     }
     else if (color_transformer == COLOR_Z)
     {
-      val = point.transformed_point.z();
+      return (scan.transform * point.point).z();
     }
-    else  // No intensity or  (color_transformer == COLOR_FLAT)
+    return 0.0f;
+  }
+
+  /**
+   * Computes the value of each point for the color transformer if it has
+   * changed and, unless the shader colors the points, their colors.  Only
+   * the color transformer changes the values; the rest of the colormap is
+   * applied by the shader.
+   */
+  void LaserScanPlugin::ColorScan(Scan& scan, const DecodeSettings& settings) const
+  {
+    const int color_transformer = settings.color_transformer;
+    bool values_changed = false;
+    if (scan.value_transformer != color_transformer)
     {
-      return ui_.min_color->color();
+      scan.flat = color_transformer == COLOR_FLAT ||
+          (color_transformer == COLOR_INTENSITY && !scan.has_intensity);
+
+      scan.gl_value.clear();
+      scan.gl_value.reserve(scan.points.size());
+      std::vector<StampedPoint>::const_iterator point_it = scan.points.begin();
+      for (; point_it != scan.points.end(); point_it++)
+      {
+        scan.gl_value.push_back(scan.flat ? 0.0f : PointValue(scan, *point_it, color_transformer));
+      }
+      scan.value_transformer = color_transformer;
+      scan.value_dirty = true;
+      values_changed = true;
     }
-    if (max_value_ > min_value_)
-      val = (val - min_value_) / (max_value_ - min_value_);
-    val = std::max(0.0, std::min(val, 1.0));
-    if (ui_.use_rainbow->isChecked())
+
+    if (settings.use_shader)
     {
-      // Hue Interpolation
-      int hue = static_cast<int>(val * 255);
-      return QColor::fromHsl(hue, 255, 127, 255);
+      scan.gl_color.clear();
     }
-    else
+    else if (values_changed || scan.settings_generation != settings.generation)
     {
-      const QColor min_color = ui_.min_color->color();
-      const QColor max_color = ui_.max_color->color();
-      // RGB Interpolation
-      int red, green, blue;
-      red = static_cast<int>(val * max_color.red()   + ((1.0 - val) * min_color.red()));
-      green = static_cast<int>(val * max_color.green() + ((1.0 - val) * min_color.green()));
-      blue = static_cast<int>(val * max_color.blue()  + ((1.0 - val) * min_color.blue()));
-      return QColor(red, green, blue, 255);
+      scan.gl_color.resize(scan.gl_value.size());
+      if (scan.flat)  // No intensity or  (color_transformer == COLOR_FLAT)
+      {
+        std::fill(scan.gl_color.begin(), scan.gl_color.end(), settings.color_lut.Flat());
+      }
+      else
+      {
+        settings.color_lut.Map(scan.gl_value.data(),
+                               scan.gl_value.size(),
+                               settings.min_value,
+                               settings.max_value,
+                               scan.gl_color.data());
+      }
+      scan.color_dirty = true;
     }
+    scan.settings_generation = settings.generation;
   }
 
   void LaserScanPlugin::UpdateColors()
   {
+    UpdateDecodeSettings();
+    RecolorScans();
+    RequestRedraw();
+  }
+
+  void LaserScanPlugin::RecolorScans()
+  {
+    const DecodeSettings settings = CopySettings();
     std::deque<Scan>::iterator scan_it = scans_.begin();
     for (; scan_it != scans_.end(); ++scan_it)
     {
-      std::vector<StampedPoint>::iterator point_it = scan_it->points.begin();
-      for (; point_it != scan_it->points.end(); point_it++)
-      {
-        point_it->color = CalculateColor(*point_it, scan_it->has_intensity);
-      }
+      ColorScan(*scan_it, settings);
     }
   }
 
@@ -290,24 +372,65 @@ namespace mapviz_plugins
     {
       initialized_ = false;
       scans_.clear();
+      next_vbo_slot_ = 0;
       has_message_ = false;
       PrintWarning("No messages received.");
 
-      laserscan_sub_.shutdown();
-
       topic_ = topic;
-      if (!topic.empty())
+      Subscribe();
+    }
+  }
+
+  void LaserScanPlugin::Subscribe()
+  {
+    laserscan_sub_.shutdown();
+    if (decode_spinner_)
+    {
+      decode_spinner_->stop();
+      decode_spinner_.reset();
+    }
+    decode_queue_.clear();
+
+    // Discard scans decoded for the previous subscription.
+    Scan* scan;
+    while (handoff_.Consume(scan))
+    {
+      handoff_.Recycle(scan);
+    }
+
+    if (!topic_.empty())
+    {
+      if (background_decode_)
+      {
+        ros::SubscribeOptions options = ros::SubscribeOptions::create<sensor_msgs::LaserScan>(
+            topic_,
+            100,
+            boost::bind(&LaserScanPlugin::backgroundLaserScanCallback, this, _1),
+            ros::VoidPtr(),
+            &decode_queue_);
+        laserscan_sub_ = node_.subscribe(options);
+
+        decode_spinner_.reset(new ros::AsyncSpinner(1, &decode_queue_));
+        decode_spinner_->start();
+      }
+      else
       {
         laserscan_sub_ = node_.subscribe(topic_,
                                          100,
                                          &LaserScanPlugin::laserScanCallback,
                                          this);
-
-        ROS_INFO("Subscribing to %s", topic_.c_str());
       }
+
+      ROS_INFO("Subscribing to %s", topic_.c_str());
     }
   }
 
+  void LaserScanPlugin::BackgroundDecodeChanged(int check_state)
+  {
+    background_decode_ = check_state == Qt::Checked;
+    Subscribe();
+  }
+
   void LaserScanPlugin::MinValueChanged(double value)
   {
     min_value_ = value;
@@ -330,12 +453,25 @@ namespace mapviz_plugins
       {
         scans_.pop_front();
       }
+
+      // Pack the surviving scans into the front of the vertex buffers so
+      // that they can be resized to the new buffer size on the next Draw().
+      for (size_t i = 0; i < scans_.size(); i++)
+      {
+        scans_[i].vbo_slot = i;
+        scans_[i].point_dirty = true;
+        scans_[i].value_dirty = true;
+        scans_[i].color_dirty = true;
+      }
+      next_vbo_slot_ = scans_.size() % buffer_size_;
     }
+    RequestRedraw();
   }
 
   void LaserScanPlugin::PointSizeChanged(int value)
   {
     point_size_ = static_cast<size_t>(value);
+    RequestRedraw();
   }
 
   void LaserScanPlugin::updatePreComputedTriginometic(const sensor_msgs::LaserScanConstPtr& msg)
@@ -385,24 +521,139 @@ namespace mapviz_plugins
       has_message_ = true;
     }
 
+    DecodeScan(msg, spare_scan_);
+
+    swri_transform_util::Transform transform;
+    spare_scan_.target_frame_ = target_frame_;
+    spare_scan_.transformed = GetScanTransform(spare_scan_, transform);
+    if (spare_scan_.transformed)
+    {
+      TransformScan(spare_scan_, transform);
+    }
+    ColorScan(spare_scan_, CopySettings());
+
+    StoreScan(spare_scan_);
+  }
+
+  void LaserScanPlugin::backgroundLaserScanCallback(const sensor_msgs::LaserScanConstPtr& msg)
+  {
+    // This runs on decode_spinner_'s thread, so it must not touch the
+    // widgets; everything it needs from the GUI comes from settings_.
+    const DecodeSettings settings = CopySettings();
+    Scan* scan = handoff_.Acquire();
+    DecodeScan(msg, *scan);
+
+    // Unlike GetScanTransform this does not fall back to the latest
+    // transform, since that would mean toggling use_latest_transforms_ from
+    // this thread; scans that fail here are retried in Transform().
+    swri_transform_util::Transform transform;
+    scan->target_frame_ = settings.target_frame;
+    scan->transformed = GetTransform(settings.target_frame, scan->source_frame_, scan->stamp, transform);
+    if (scan->transformed)
+    {
+      TransformScan(*scan, transform);
+    }
+    ColorScan(*scan, settings);
+
+    if (handoff_.Publish(scan))
+    {
+      QMetaObject::invokeMethod(this, "ConsumeDecodedScans", Qt::QueuedConnection);
+    }
+  }
+
+  void LaserScanPlugin::ConsumeDecodedScans()
+  {
+    Scan* scan;
+    while (handoff_.Consume(scan))
+    {
+      ProcessScan(*scan);
+      handoff_.Recycle(scan);
+    }
+  }
+
+  void LaserScanPlugin::ProcessScan(Scan& scan)
+  {
+    if (!has_message_)
+    {
+      initialized_ = true;
+      has_message_ = true;
+    }
+
+    const DecodeSettings settings = CopySettings();
+    if (scan.settings_generation != settings.generation)
+    {
+      // The settings changed while the scan was being decoded.
+      if (scan.target_frame_ != settings.target_frame)
+      {
+        scan.transformed = false;
+      }
+      ColorScan(scan, settings);
+    }
+
+    StoreScan(scan);
+  }
+
+  void LaserScanPlugin::StoreScan(Scan& scan)
+  {
+    // If there are more items in the scan buffer than buffer_size_, remove
+    // them, handing the oldest back so that its memory is reused.
+    Scan evicted;
+    if (buffer_size_ > 0)
+    {
+      if (scans_.size() >= buffer_size_)
+      {
+        evicted = std::move(scans_.front());
+      }
+      while (scans_.size() >= buffer_size_)
+      {
+        scans_.pop_front();
+      }
+      // Scans are evicted in FIFO order, so the next slot is either unused
+      // or belonged to the scan that was just evicted.
+      scan.vbo_slot = next_vbo_slot_;
+      next_vbo_slot_ = (next_vbo_slot_ + 1) % buffer_size_;
+    }
+    else
+    {
+      scan.vbo_slot = scans_.size();
+    }
+    scan.point_dirty = true;
+    scan.value_dirty = true;
+    scan.color_dirty = true;
+
+    scans_.push_back(std::move(scan));
+    scan = std::move(evicted);
+
+    // Scans decoded in the background arrive on decode_queue_, which the
+    // canvas doesn't watch, so it has to be told about them.
+    RequestRedraw();
+  }
+
+  void LaserScanPlugin::DecodeScan(const sensor_msgs::LaserScanConstPtr& msg, Scan& scan)
+  {
     // Note that unlike some plugins, this one does not store nor rely on the
     // source_frame_ member variable.  This one can potentially store many
     // messages with different source frames, so we need to store and transform
     // them individually.
 
-    Scan scan;
     scan.stamp = msg->header.stamp;
     scan.color = QColor::fromRgbF(1.0f, 0.0f, 0.0f, 1.0f);
     scan.source_frame_ = msg->header.frame_id;
     scan.has_intensity = !msg->intensities.empty();
+    scan.transformed = false;
+    scan.rigid = true;
+    scan.points.clear();
     scan.points.reserve( msg->ranges.size() );
+    scan.value_transformer = -1;
+    scan.gl_point.clear();
+    scan.gl_point.reserve(msg->ranges.size() * 2);
+    scan.gl_value.clear();
+    scan.gl_color.clear();
+    scan.local_bounds.Clear();
 
     double x, y;
     updatePreComputedTriginometic(msg);
 
-    swri_transform_util::Transform transform;
-    scan.transformed = GetScanTransform(scan, transform);
-
     for (size_t i = 0; i < msg->ranges.size(); i++)
     {
       // Discard the point if it's out of range
@@ -418,22 +669,64 @@ namespace mapviz_plugins
       if (i < msg->intensities.size())
         point.intensity = msg->intensities[i];
 
-      if (scan.transformed)
-      {
-        point.transformed_point = transform * point.point;
-      }
-      point.color = CalculateColor(point, scan.has_intensity);
       scan.points.push_back(point);
+      scan.local_bounds.Extend(point.point);
+      scan.gl_point.push_back(x);
+      scan.gl_point.push_back(y);
     }
-    scans_.push_back(scan);
+  }
 
-    // If there are more items in the scan buffer than buffer_size_, remove them
-    if (buffer_size_ > 0)
+  /**
+   * Transforms a scan to its target frame.  The points stay in the source
+   * frame and are drawn with the transform as a matrix, so this doesn't
+   * touch them unless the transform isn't rigid.
+   */
+  void LaserScanPlugin::TransformScan(Scan& scan, const swri_transform_util::Transform& transform)
+  {
+    // Transforms to or from WGS84 can't be expressed as a matrix.
+    const bool rigid =
+        !swri_transform_util::FrameIdsEqual(scan.source_frame_, swri_transform_util::_wgs84_frame) &&
+        !swri_transform_util::FrameIdsEqual(scan.target_frame_, swri_transform_util::_wgs84_frame);
+
+    scan.transform = transform;
+    scan.matrix = tf::Transform(transform.GetOrientation(), transform.GetOrigin());
+    if (rigid)
     {
-      while (scans_.size() > buffer_size_)
+      if (!scan.rigid)
       {
-        scans_.pop_front();
+        // Put back the source frame points
+        scan.gl_point.clear();
+        std::vector<StampedPoint>::const_iterator point_it = scan.points.begin();
+        for (; point_it != scan.points.end(); ++point_it)
+        {
+          scan.gl_point.push_back(point_it->point.getX());
+          scan.gl_point.push_back(point_it->point.getY());
+        }
+        scan.point_dirty = true;
+      }
+      scan.bounds = scan.local_bounds.Transformed(scan.matrix);
+    }
+    else
+    {
+      scan.gl_point.clear();
+      scan.bounds.Clear();
+      std::vector<StampedPoint>::const_iterator point_it = scan.points.begin();
+      for (; point_it != scan.points.end(); ++point_it)
+      {
+        const tf::Point transformed_point = transform * point_it->point;
+        scan.bounds.Extend(transformed_point);
+        scan.gl_point.push_back(transformed_point.getX());
+        scan.gl_point.push_back(transformed_point.getY());
       }
+      scan.point_dirty = true;
+    }
+    scan.rigid = rigid;
+    scan.transformed = true;
+
+    // Z values are taken from the transformed points
+    if (scan.value_transformer == COLOR_Z)
+    {
+      scan.value_transformer = -1;
     }
   }
 
@@ -468,37 +761,214 @@ namespace mapviz_plugins
     return true;
   }
 
-  void LaserScanPlugin::Draw(double x, double y, double scale)
+  void LaserScanPlugin::UpdateVertexBuffers()
   {
-    glPointSize(point_size_);
-    glBegin(GL_POINTS);
+    size_t num_slots = buffer_size_;
+    if (buffer_size_ == 0)
+    {
+      // The buffer is unbounded, so grow geometrically rather than
+      // reallocating for every scan.
+      num_slots = std::max(num_slots_, static_cast<size_t>(1));
+      while (num_slots < scans_.size())
+      {
+        num_slots *= 2;
+      }
+    }
 
+    size_t slot_capacity = slot_capacity_;
     std::deque<Scan>::const_iterator scan_it = scans_.begin();
-    while (scan_it != scans_.end())
+    for (; scan_it != scans_.end(); ++scan_it)
     {
-      if (scan_it->transformed)
+      slot_capacity = std::max(slot_capacity, scan_it->gl_point.size() / 2);
+      slot_capacity = std::max(slot_capacity, scan_it->gl_value.size());
+      slot_capacity = std::max(slot_capacity, scan_it->gl_color.size());
+    }
+
+    if (point_vbo_ == 0)
+    {
+      glGenBuffers(1, &point_vbo_);
+      glGenBuffers(1, &value_vbo_);
+      glGenBuffers(1, &color_vbo_);
+    }
+
+    if (num_slots != num_slots_ || slot_capacity != slot_capacity_)
+    {
+      num_slots_ = num_slots;
+      slot_capacity_ = slot_capacity;
+
+      glBindBuffer(GL_ARRAY_BUFFER, point_vbo_);
+      glBufferData(GL_ARRAY_BUFFER, num_slots_ * slot_capacity_ * 2 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+      glBindBuffer(GL_ARRAY_BUFFER, value_vbo_);
+      glBufferData(GL_ARRAY_BUFFER, num_slots_ * slot_capacity_ * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+      // Colors are only needed when they are computed on the CPU
+      const size_t color_slots = use_shader_ ? 0 : num_slots_;
+      glBindBuffer(GL_ARRAY_BUFFER, color_vbo_);
+      glBufferData(GL_ARRAY_BUFFER, color_slots * slot_capacity_ * sizeof(uint32_t), NULL, GL_DYNAMIC_DRAW);
+
+      std::deque<Scan>::iterator it = scans_.begin();
+      for (; it != scans_.end(); ++it)
       {
-        std::vector<StampedPoint>::const_iterator point_it = scan_it->points.begin();
-        for (; point_it != scan_it->points.end(); ++point_it)
-        {
-          glColor4d(
-              point_it->color.redF(),
-              point_it->color.greenF(),
-              point_it->color.blueF(),
-              alpha_);
-          glVertex2d(
-              point_it->transformed_point.getX(),
-              point_it->transformed_point.getY());
-        }
+        it->point_dirty = true;
+        it->value_dirty = true;
+        it->color_dirty = true;
+      }
+    }
+
+    // Only scans that are new, re-transformed or re-colored since the last
+    // frame are sent to the GPU; everything else is already there.
+    std::deque<Scan>::iterator it = scans_.begin();
+    for (; it != scans_.end(); ++it)
+    {
+      if (it->point_dirty)
+      {
+        glBindBuffer(GL_ARRAY_BUFFER, point_vbo_);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        it->vbo_slot * slot_capacity_ * 2 * sizeof(float),
+                        it->gl_point.size() * sizeof(float),
+                        it->gl_point.data());
+        it->point_dirty = false;
+      }
+      if (it->value_dirty && use_shader_)
+      {
+        glBindBuffer(GL_ARRAY_BUFFER, value_vbo_);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        it->vbo_slot * slot_capacity_ * sizeof(float),
+                        it->gl_value.size() * sizeof(float),
+                        it->gl_value.data());
+        it->value_dirty = false;
+      }
+      if (it->color_dirty && !use_shader_)
+      {
+        glBindBuffer(GL_ARRAY_BUFFER, color_vbo_);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        it->vbo_slot * slot_capacity_ * sizeof(uint32_t),
+                        it->gl_color.size() * sizeof(uint32_t),
+                        it->gl_color.data());
+        it->color_dirty = false;
       }
-      ++scan_it;
     }
+  }
+
+  void LaserScanPlugin::DeleteVertexBuffers()
+  {
+    if (point_vbo_ != 0)
+    {
+      glDeleteBuffers(1, &point_vbo_);
+      glDeleteBuffers(1, &value_vbo_);
+      glDeleteBuffers(1, &color_vbo_);
+      point_vbo_ = 0;
+      value_vbo_ = 0;
+      color_vbo_ = 0;
+    }
+    num_slots_ = 0;
+    slot_capacity_ = 0;
+  }
+
+  void LaserScanPlugin::Draw(double x, double y, double scale)
+  {
+    if (!shader_checked_)
+    {
+      use_shader_ = colormap_shader_.Initialize(canvas_->context());
+      shader_checked_ = true;
+      // Drop the colors computed on the CPU until now
+      UpdateColors();
+    }
+
+    UpdateVertexBuffers();
+
+    if (!scans_.empty())
+    {
+      glPointSize(point_size_);
+
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glBindBuffer(GL_ARRAY_BUFFER, point_vbo_);
+      glVertexPointer(2, GL_FLOAT, 0, 0);
+
+      if (use_shader_)
+      {
+        colormap_shader_.Bind(min_value_,
+                              max_value_,
+                              ui_.use_rainbow->isChecked(),
+                              ui_.min_color->color(),
+                              ui_.max_color->color(),
+                              alpha_);
+
+        const int value_location = colormap_shader_.ValueLocation();
+        glEnableVertexAttribArray(value_location);
+        glBindBuffer(GL_ARRAY_BUFFER, value_vbo_);
+        glVertexAttribPointer(value_location, 1, GL_FLOAT, GL_FALSE, 0, 0);
+
+        DrawScans(scale);
+
+        glDisableVertexAttribArray(value_location);
+        colormap_shader_.Release();
+      }
+      else
+      {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, color_vbo_);
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, 0);
 
-    glEnd();
+        DrawScans(scale);
+
+        glDisableClientState(GL_COLOR_ARRAY);
+      }
+
+      glDisableClientState(GL_VERTEX_ARRAY);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
     PrintInfo("OK");
   }
 
+  /**
+   * Draws each visible scan from its slot of the bound vertex buffers, with
+   * its transform on the modelview matrix when it is rigid.
+   */
+  void LaserScanPlugin::DrawScans(double scale)
+  {
+    std::deque<Scan>::const_iterator scan_it = scans_.begin();
+    for (; scan_it != scans_.end(); ++scan_it)
+    {
+      const size_t num_colors = use_shader_ ? scan_it->gl_value.size() : scan_it->gl_color.size();
+      const size_t num_points = std::min(scan_it->gl_point.size() / 2, num_colors);
+      if (!scan_it->transformed || num_points == 0)
+      {
+        continue;
+      }
+
+      // Skip scans that are entirely off screen
+      mapviz::BoundingBox bounds = scan_it->bounds;
+      bounds.Pad(point_size_ * scale);
+      if (!draw_context_.IsVisible(bounds))
+      {
+        continue;
+      }
+
+      if (use_shader_)
+      {
+        colormap_shader_.SetFlat(scan_it->flat);
+      }
+
+      if (scan_it->rigid)
+      {
+        double matrix[16];
+        mapviz::GetPlanarGLMatrix(scan_it->matrix, matrix);
+        glPushMatrix();
+        glMultMatrixd(matrix);
+      }
+
+      glDrawArrays(GL_POINTS,
+                   static_cast<GLint>(scan_it->vbo_slot * slot_capacity_),
+                   static_cast<GLsizei>(num_points));
+
+      if (scan_it->rigid)
+      {
+        glPopMatrix();
+      }
+    }
+  }
+
   void LaserScanPlugin::UseRainbowChanged(int check_state)
   {
     if (check_state == Qt::Checked)
@@ -520,6 +990,7 @@ namespace mapviz_plugins
 
   void LaserScanPlugin::Transform()
   {
+    const DecodeSettings settings = CopySettings();
     std::deque<Scan>::iterator scan_it = scans_.begin();
     for (; scan_it != scans_.end(); ++scan_it)
     {
@@ -531,24 +1002,16 @@ namespace mapviz_plugins
 
           if ( GetScanTransform( scan, transform) )
           {
-              scan.transformed = true;
-              std::vector<StampedPoint>::iterator point_it = scan.points.begin();
-              for (; point_it != scan.points.end(); ++point_it)
-              {
-                  point_it->transformed_point = transform * point_it->point;
-              }
+              scan.target_frame_ = target_frame_;
+              TransformScan(scan, transform);
+              // Only needed for Z values, which depend on the transform
+              ColorScan(scan, settings);
           }
           else{
               PrintError("No transform between " + scan.source_frame_ + " and " + target_frame_);
           }
       }
     }
-    // Z color is based on transformed color, so it is dependent on the
-    // transform
-    if (ui_.color_transformer->currentIndex() == COLOR_Z)
-    {
-      UpdateColors();
-    }
   }
 
   void LaserScanPlugin::LoadConfig(const YAML::Node& node,
@@ -574,6 +1037,13 @@ namespace mapviz_plugins
       ui_.bufferSize->setValue(static_cast<int>(buffer_size_));
     }
 
+    if (node["background_decode"])
+    {
+      bool background_decode;
+      node["background_decode"] >> background_decode;
+      ui_.background_decode->setChecked(background_decode);
+    }
+
     if (node["color_transformer"])
     {
       std::string color_transformer;
@@ -679,6 +1149,7 @@ namespace mapviz_plugins
   void LaserScanPlugin::AlphaEdited(double val)
   {
     alpha_ = std::max(0.0f, std::min((float)val, 1.0f));
+    UpdateColors();
   }
 
   void LaserScanPlugin::SaveConfig(YAML::Emitter& emitter,
@@ -690,6 +1161,8 @@ namespace mapviz_plugins
                YAML::Value << ui_.pointSize->value();
     emitter << YAML::Key << "buffer_size" <<
                YAML::Value << ui_.bufferSize->value();
+    emitter << YAML::Key << "background_decode" <<
+               YAML::Value << ui_.background_decode->isChecked();
     emitter << YAML::Key << "alpha" <<
                YAML::Value << alpha_;
     emitter << YAML::Key << "color_transformer" <<
@@ -27,14 +27,27 @@
 //
 // *****************************************************************************
 
+#include <GL/glew.h>
 #include <mapviz_plugins/marker_plugin.h>
 
+// C++ standard libraries
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
 #include <mapviz/select_topic_dialog.h>
 
 #include <swri_math_util/constants.h>
+#include <swri_transform_util/frames.h>
+#include <swri_transform_util/transform_util.h>
 
 #include <boost/algorithm/string.hpp>
 
+// QT libraries
+#include <QCursor>
+#include <QToolTip>
+
 // Declare plugin
 #include <pluginlib/class_list_macros.h>
 PLUGINLIB_EXPORT_CLASS(mapviz_plugins::MarkerPlugin, mapviz::MapvizPlugin)
@@ -44,12 +57,101 @@ namespace mapviz_plugins
 #define IS_INSTANCE(msg, type) \
   (msg->getDataType() == ros::message_traits::datatype<type>())
 
+  // Distance in pixels from a marker that the mouse can be and still pick it
+  const double HOVER_TOLERANCE = 5.0;
+
+  // Number of out of date entries the expiry queue may hold before it is
+  // rebuilt
+  const size_t EXPIRY_QUEUE_SLACK = 1024;
+
+  // Number of triangles used to draw circles
+  const int32_t CIRCLE_SEGMENTS = 36;
+
+  // How far a frame's z axis may lean, as its length in the target frame's
+  // XY plane, for circles and squares in the frame to be drawn untilted
+  const double LEVEL_TOLERANCE = 0.01;
+
+  // Location of the unit shapes in the instancing shape buffer
+  const GLint SQUARE_FIRST = 0;
+  const GLsizei SQUARE_COUNT = 6;
+  const GLint CIRCLE_FIRST = SQUARE_FIRST + SQUARE_COUNT;
+  const GLsizei CIRCLE_COUNT = CIRCLE_SEGMENTS * 3;
+  const GLint POINT_FIRST = CIRCLE_FIRST + CIRCLE_COUNT;
+  const GLsizei POINT_COUNT = 1;
+
+  // Number of ADDs after which the hit rate counts are halved, so that the
+  // reported rate follows recent messages
+  const uint32_t HIT_RATE_WINDOW = 1000;
+
+  /**
+   * Returns true for the list marker types that can be drawn with instancing.
+   */
+  static bool IsInstanceable(int display_type)
+  {
+    return display_type == visualization_msgs::Marker::CUBE_LIST ||
+        display_type == visualization_msgs::Marker::SPHERE_LIST ||
+        display_type == visualization_msgs::Marker::POINTS;
+  }
+
+  /**
+   * Returns true for the marker types that are drawn as circles or squares
+   * around their points.
+   */
+  static bool HasShapes(int display_type)
+  {
+    return display_type == visualization_msgs::Marker::CYLINDER ||
+        display_type == visualization_msgs::Marker::SPHERE ||
+        display_type == visualization_msgs::Marker::SPHERE_LIST ||
+        display_type == visualization_msgs::Marker::CUBE_LIST;
+  }
+
+  /**
+   * Returns true if a transform keeps the XY plane level, so that circles
+   * and squares in it aren't squashed when they are projected onto the
+   * target frame's XY plane.
+   */
+  static bool IsLevel(const tf::Transform& transform)
+  {
+    const tf::Vector3 z_axis = transform.getBasis().getColumn(2);
+    return std::abs(z_axis.x()) < LEVEL_TOLERANCE && std::abs(z_axis.y()) < LEVEL_TOLERANCE;
+  }
+
+  /**
+   * Returns the distance in the XY plane from a point to a line segment.
+   */
+  static double DistanceToSegment(const tf::Point& point, const tf::Point& start, const tf::Point& end)
+  {
+    const double dx = end.x() - start.x();
+    const double dy = end.y() - start.y();
+    const double length_sq = dx * dx + dy * dy;
+    double t = 0.0;
+    if (length_sq > 0.0)
+    {
+      t = ((point.x() - start.x()) * dx + (point.y() - start.y()) * dy) / length_sq;
+      t = std::max(0.0, std::min(1.0, t));
+    }
+    return std::hypot(point.x() - (start.x() + t * dx), point.y() - (start.y() + t * dy));
+  }
+
   MarkerPlugin::MarkerPlugin() :
     config_widget_(new QWidget()),
-    connected_(false)
+    connected_(false),
+    hovering_marker_(false),
+    instancing_checked_(false),
+    use_instancing_(false),
+    shape_buffer_(0),
+    marker_generation_(0),
+    marker_updates_(0),
+    marker_hits_(0)
   {
     ui_.setupUi(config_widget_);
 
+    // Markers are transformed as they arrive; Transform() only needs to run
+    // again when tf data or the target frame changes.
+    transform_on_change_ = true;
+
+    text_cache_.SetFont(QFont("Helvetica", 10));
+
     // Set background white
     QPalette p(config_widget_->palette());
     p.setColor(QPalette::Background, Qt::white);
@@ -63,20 +165,64 @@ namespace mapviz_plugins
     QObject::connect(ui_.selecttopic, SIGNAL(clicked()), this, SLOT(SelectTopic()));
     QObject::connect(ui_.topic, SIGNAL(editingFinished()), this, SLOT(TopicEdited()));
     QObject::connect(ui_.clear, SIGNAL(clicked()), this, SLOT(ClearHistory()));
+    QObject::connect(ui_.nsList, SIGNAL(itemChanged(QListWidgetItem*)), this,
+        SLOT(NamespaceChanged(QListWidgetItem*)));
+    QObject::connect(ui_.declutter, SIGNAL(toggled(bool)), this, SLOT(DeclutterToggled(bool)));
 
     startTimer(1000);
   }
 
   MarkerPlugin::~MarkerPlugin()
   {
+    for (const auto& marker : markers_)
+    {
+      if (marker.second.instance_buffer != 0)
+      {
+        unused_buffers_.push_back(marker.second.instance_buffer);
+      }
+    }
+    if (shape_buffer_ != 0)
+    {
+      unused_buffers_.push_back(shape_buffer_);
+    }
+    if (!unused_buffers_.empty())
+    {
+      glDeleteBuffers(static_cast<GLsizei>(unused_buffers_.size()), unused_buffers_.data());
+    }
   }
 
   void MarkerPlugin::ClearHistory()
   {
     ROS_DEBUG("MarkerPlugin::ClearHistory()");
-    markers_.clear();
-    marker_visible_.clear();
+    clearMarkers();
+    namespace_ids_.clear();
+    namespace_visible_.clear();
     ui_.nsList->clear();
+    marker_updates_ = 0;
+    marker_hits_ = 0;
+  }
+
+  void MarkerPlugin::NamespaceChanged(QListWidgetItem* item)
+  {
+    bool ok = false;
+    const uint32_t ns_id = item->data(Qt::UserRole).toUInt(&ok);
+    if (ok && ns_id < namespace_visible_.size())
+    {
+      namespace_visible_[ns_id] = item->checkState() == Qt::Checked;
+      for (auto& marker : markers_)
+      {
+        if (marker.second.ns_id == ns_id)
+        {
+          updateGeometryTransform(marker.second);
+        }
+      }
+      RequestRedraw();
+    }
+  }
+
+  void MarkerPlugin::DeclutterToggled(bool checked)
+  {
+    RequestRedraw();
   }
 
   void MarkerPlugin::SelectTopic()
@@ -100,9 +246,12 @@ namespace mapviz_plugins
     if (topic != topic_)
     {
       initialized_ = false;
-      markers_.clear();
-      marker_visible_.clear();
+      clearMarkers();
+      namespace_ids_.clear();
+      namespace_visible_.clear();
       ui_.nsList->clear();
+      marker_updates_ = 0;
+      marker_hits_ = 0;
       has_message_ = false;
       PrintWarning("No messages received.");
 
@@ -157,9 +306,35 @@ namespace mapviz_plugins
     // messages with different source frames, so we need to store and transform
     // them individually.
 
+    // Markers are transformed as they arrive, so they only need Transform()
+    // to run again if their transform isn't available yet.
+    RequestRedraw();
+
     if (marker.action == visualization_msgs::Marker::ADD)
     {
-      MarkerData& markerData = markers_[std::make_pair(marker.ns, marker.id)];
+      const MarkerId id(marker.ns, marker.id);
+      const std::size_t content_hash = HashMarker(marker);
+
+      if (++marker_updates_ > HIT_RATE_WINDOW)
+      {
+        marker_updates_ /= 2;
+        marker_hits_ /= 2;
+      }
+
+      // Nodes that republish all of their markers at a fixed rate mostly
+      // send the same markers over again; those only need a new lifetime and
+      // possibly a new transform.
+      auto markerIter = markers_.find(id);
+      if (markerIter != markers_.end() && markerIter->second.content_hash == content_hash)
+      {
+        marker_hits_++;
+        refreshMarker(id, markerIter->second, marker);
+        return;
+      }
+
+      MarkerData& markerData = markers_[id];
+      markerData.content_hash = content_hash;
+      markerData.generation = marker_generation_;
       markerData.points.clear(); // clear marker points
       markerData.text.clear(); // clear marker text
       markerData.stamp = marker.header.stamp;
@@ -171,12 +346,16 @@ namespace mapviz_plugins
       markerData.transformed = true;
       markerData.source_frame = marker.header.frame_id;
 
-      if (marker_visible_.emplace(marker.ns, true).second)
+      auto ns = namespace_ids_.emplace(marker.ns, static_cast<uint32_t>(namespace_visible_.size()));
+      markerData.ns_id = ns.first->second;
+      if (ns.second)
       {
+        namespace_visible_.push_back(true);
+
         QString name_string(marker.ns.c_str());
         auto* item = new QListWidgetItem(name_string, ui_.nsList);
+        item->setData(Qt::UserRole, markerData.ns_id);
         item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-        item->setCheckState(Qt::Unchecked);
         item->setCheckState(Qt::Checked);
         //item->setData(Qt::StatusTipRole, layer_string);
       }
@@ -197,56 +376,55 @@ namespace mapviz_plugins
                                      marker.pose.orientation.w);
       }
 
-      markerData.local_transform = swri_transform_util::Transform(
-        tf::Transform(
+      tf::Transform local_transform(
           orientation,
           tf::Vector3(marker.pose.position.x,
                       marker.pose.position.y,
-                      marker.pose.position.z)));
-
-      markerData.points.clear();
-      markerData.text = std::string();
+                      marker.pose.position.z));
 
-      swri_transform_util::Transform transform;
-      if (!GetTransform(markerData.source_frame, marker.header.stamp, transform))
+      const SharedTransform& shared = acquireTransform(markerData);
+      if (!shared.valid)
       {
         markerData.transformed = false;
         PrintError("No transform between " + markerData.source_frame + " and " + target_frame_);
+        DataChanged();
       }
-
-      // Handle lifetime parameter
-      ros::Duration lifetime = marker.lifetime;
-      if (lifetime.isZero())
-      {
-        markerData.expire_time = ros::TIME_MAX;
-      }
-      else
-      {
-        // Temporarily add 5 seconds to fix some existing markers.
-        markerData.expire_time = ros::Time::now() + lifetime + ros::Duration(5);
-      }
+      setTransform(id, markerData, shared.transform);
+      setLifetime(id, markerData, marker.lifetime);
 
       if (markerData.display_type == visualization_msgs::Marker::ARROW)
       {
         StampedPoint point;
         point.color = markerData.color;
-        point.orientation = orientation;
 
+        tf::Vector3 head_offset;
         if (marker.points.empty())
         {
           // If the "points" array is empty, we'll use the pose as the base of
           // the arrow and scale its size based on the scale_x value.
-          point.point = markerData.local_transform * tf::Point(0.0, 0.0, 0.0);
-          point.arrow_point = markerData.local_transform * tf::Point(1.0, 0.0, 0.0);
+          point.point = local_transform * tf::Point(0.0, 0.0, 0.0);
+          point.arrow_point = local_transform * tf::Point(markerData.scale_x, 0.0, 0.0);
+          head_offset = tf::Vector3(0.25, 0.0, 0.0);
         }
         else
         {
           // Otherwise the "points" array should have exactly two values, the
           // start and end of the arrow.
-          point.point = markerData.local_transform * tf::Point(marker.points[0].x, marker.points[0].y, marker.points[0].z);
-          point.arrow_point = markerData.local_transform * tf::Point(marker.points[1].x, marker.points[1].y, marker.points[1].z);
+          point.point = local_transform * tf::Point(marker.points[0].x, marker.points[0].y, marker.points[0].z);
+          point.arrow_point = local_transform * tf::Point(marker.points[1].x, marker.points[1].y, marker.points[1].z);
+          // Also, in this mode, scale_y is the diameter of the arrow's head.
+          head_offset = tf::Vector3(0.25 * markerData.scale_y, 0.0, 0.0);
         }
 
+        tf::Vector3 pointDiff = point.arrow_point - point.point;
+        double angle = std::atan2(pointDiff.getY(), pointDiff.getX());
+
+        tf::Transform left_tf(tf::createQuaternionFromRPY(0, 0, M_PI*0.75 + angle));
+        tf::Transform right_tf(tf::createQuaternionFromRPY(0, 0, -M_PI*0.75 + angle));
+
+        point.arrow_left = point.arrow_point + left_tf * head_offset;
+        point.arrow_right = point.arrow_point + right_tf * head_offset;
+
         markerData.points.push_back(point);
 
         if (!marker.points.empty())
@@ -256,39 +434,32 @@ namespace mapviz_plugins
           // only to indicate whether the original message had two points or not.
           markerData.points.push_back(StampedPoint());
         }
-
-        transformArrow(markerData, transform);
       }
       else if (markerData.display_type == visualization_msgs::Marker::CYLINDER ||
         markerData.display_type == visualization_msgs::Marker::SPHERE ||
         markerData.display_type == visualization_msgs::Marker::TEXT_VIEW_FACING)
       {
         StampedPoint point;
-        point.point = tf::Point(0.0, 0.0, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
+        point.point = local_transform * tf::Point(0.0, 0.0, 0.0);
         point.color = markerData.color;
         markerData.points.push_back(point);
-        markerData.text = marker.text;
+        markerData.text = QString::fromStdString(marker.text);
       }
       else if (markerData.display_type == visualization_msgs::Marker::CUBE)
       {
         StampedPoint point;
         point.color = markerData.color;
 
-        point.point = tf::Point(marker.scale.x / 2, marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
+        point.point = local_transform * tf::Point(marker.scale.x / 2, marker.scale.y / 2, 0.0);
         markerData.points.push_back(point);
 
-        point.point = tf::Point(-marker.scale.x / 2, marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
+        point.point = local_transform * tf::Point(-marker.scale.x / 2, marker.scale.y / 2, 0.0);
         markerData.points.push_back(point);
 
-        point.point = tf::Point(-marker.scale.x / 2, -marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
+        point.point = local_transform * tf::Point(-marker.scale.x / 2, -marker.scale.y / 2, 0.0);
         markerData.points.push_back(point);
 
-        point.point = tf::Point(marker.scale.x / 2, -marker.scale.y / 2, 0.0);
-        point.transformed_point = transform * (markerData.local_transform * point.point);
+        point.point = local_transform * tf::Point(marker.scale.x / 2, -marker.scale.y / 2, 0.0);
         markerData.points.push_back(point);
       }
       else if (markerData.display_type == visualization_msgs::Marker::LINE_STRIP ||
@@ -302,8 +473,7 @@ namespace mapviz_plugins
         StampedPoint point;
         for (unsigned int i = 0; i < marker.points.size(); i++)
         {
-          point.point = tf::Point(marker.points[i].x, marker.points[i].y, marker.points[i].z);
-          point.transformed_point = transform * (markerData.local_transform * point.point);
+          point.point = local_transform * tf::Point(marker.points[i].x, marker.points[i].y, marker.points[i].z);
 
           if (i < marker.colors.size())
           {
@@ -321,276 +491,1025 @@ namespace mapviz_plugins
       {
         ROS_WARN_ONCE("Unsupported marker type: %d", markerData.display_type);
       }
+
+      updateLocalBounds(markerData);
+      updateBounds(id, markerData);
+      markGeometryDirty(id, markerData);
     }
     else if (marker.action == visualization_msgs::Marker::DELETE)
     {
-      markers_.erase(std::make_pair(marker.ns, marker.id));
+      removeMarker(MarkerId(marker.ns, marker.id));
     }
     else if (marker.action == 3) // The DELETEALL enum doesn't exist in Indigo
     {
-      markers_.clear();
+      clearMarkers();
     }
   }
 
   /**
-   * Given a MarkerData that represents an arrow and a transform, this function
-   * will generate the points involved in drawing the arrow and then transform
-   * all of them into the target frame.
-   * @param[inout] markerData A marker that represents an arrow.
-   * @param[in] transform The tf that should be applied to the arrow's points.
+   * Updates a marker that was published again with the same contents.  Its
+   * points and geometry are kept; only its lifetime and, if the message has
+   * a new stamp, its transform are updated.
    */
-  void MarkerPlugin::transformArrow(MarkerData& markerData,
-                      const swri_transform_util::Transform& transform)
-  {
-    // The first point in the markerData.points array always represents the
-    // base of the arrow.
-    StampedPoint& point = markerData.points.front();
-    tf::Point arrowOffset;
-    if (markerData.points.size() == 1)
-    {
-      // If the markerData only has a single point, that means its "point" is
-      // the base of the arrow and the arrow's angle and length are determined
-      // by the orientation and scale_x.
-      point.transformed_point = transform * (markerData.local_transform * point.point);
-      tf::Transform arrow_tf(tf::Transform(
-          transform.GetOrientation()) * point.orientation,
-          tf::Point(0.0, 0.0, 0.0));
-      point.transformed_arrow_point = point.transformed_point +
-          arrow_tf * point.arrow_point * markerData.scale_x;
-      arrowOffset = tf::Point(0.25, 0.0, 0.0);
+  void MarkerPlugin::refreshMarker(const MarkerId& id,
+                                   MarkerData& markerData,
+                                   const visualization_msgs::Marker& marker)
+  {
+    markerData.generation = marker_generation_;
+    setLifetime(id, markerData, marker.lifetime);
+
+    if (marker.header.stamp == markerData.stamp)
+    {
+      return;
+    }
+
+    markerData.stamp = marker.header.stamp;
+    const SharedTransform& shared = acquireTransform(markerData);
+    markerData.transformed = shared.valid;
+    if (!markerData.transformed)
+    {
+      PrintError("No transform between " + markerData.source_frame + " and " + target_frame_);
+      DataChanged();
+    }
+    setTransform(id, markerData, shared.transform);
+    updateBounds(id, markerData);
+
+    if (markerData.rigid)
+    {
+      updateGeometryTransform(markerData);
     }
     else
     {
-      // If the markerData has two points, that means that the start and end points
-      // of the arrow were explicitly specified in the original message, so the
-      // length and angle are determined by them.
-      point.transformed_point = transform * point.point;
-      point.transformed_arrow_point = transform * point.arrow_point;
-      // Also, in this mode, scale_y is the diameter of the arrow's head.
-      arrowOffset = tf::Point(0.25 * markerData.scale_y, 0.0, 0.0);
+      markGeometryDirty(id, markerData);
     }
+  }
 
-    tf::Vector3 pointDiff = point.transformed_arrow_point - point.transformed_point;
-    double angle = std::atan2(pointDiff.getY(), pointDiff.getX());
+  void MarkerPlugin::setLifetime(const MarkerId& id,
+                                 MarkerData& markerData,
+                                 const ros::Duration& lifetime)
+  {
+    if (lifetime.isZero())
+    {
+      markerData.expire_time = ros::TIME_MAX;
+    }
+    else
+    {
+      // Temporarily add 5 seconds to fix some existing markers.
+      markerData.expire_time = ros::Time::now() + lifetime + ros::Duration(5);
+    }
+    expiry_queue_.Push(id, markerData.expire_time);
+  }
 
-    tf::Transform left_tf(tf::createQuaternionFromRPY(0, 0, M_PI*0.75 + angle));
-    tf::Transform right_tf(tf::createQuaternionFromRPY(0, 0, -M_PI*0.75 + angle));
+  /**
+   * Points a marker at the shared transform for its frame and stamp,
+   * looking the transform up if no other marker uses it yet.
+   */
+  const MarkerPlugin::SharedTransform& MarkerPlugin::acquireTransform(MarkerData& markerData)
+  {
+    // With the latest transforms, the stamp doesn't matter.
+    const TransformKey key(markerData.source_frame,
+                           use_latest_transforms_ ? ros::Time() : markerData.stamp);
+    if (markerData.shared_transform != NULL && markerData.shared_transform->key == key)
+    {
+      return *markerData.shared_transform;
+    }
+
+    releaseTransform(markerData);
 
-    point.transformed_arrow_left = point.transformed_arrow_point + left_tf * arrowOffset;
-    point.transformed_arrow_right = point.transformed_arrow_point + right_tf * arrowOffset;
+    auto inserted = shared_transforms_.emplace(key, SharedTransform());
+    SharedTransform& shared = inserted.first->second;
+    if (inserted.second)
+    {
+      shared.key = key;
+      shared.id = 0;
+      shared.users = 0;
+      lookupTransform(shared);
+    }
+    shared.users++;
+    markerData.shared_transform = &shared;
+    return shared;
   }
 
-  void MarkerPlugin::handleMarkerArray(const visualization_msgs::MarkerArray &markers)
+  void MarkerPlugin::releaseTransform(MarkerData& markerData)
   {
-    for (unsigned int i = 0; i < markers.markers.size(); i++)
+    SharedTransform* shared = markerData.shared_transform;
+    if (shared == NULL)
     {
-      handleMarker(markers.markers[i]);
+      return;
+    }
+
+    markerData.shared_transform = NULL;
+    if (--shared->users == 0)
+    {
+      if (geometry_renderer_ && shared->id != 0)
+      {
+        geometry_renderer_->RemoveTransform(shared->id);
+      }
+      shared_transforms_.erase(shared->key);
     }
   }
 
-  void MarkerPlugin::PrintError(const std::string& message)
+  /**
+   * Looks up a shared transform and hands its matrix to the geometry
+   * renderer.
+   */
+  void MarkerPlugin::lookupTransform(SharedTransform& shared)
   {
-    PrintErrorHelper(ui_.status, message);
+    shared.valid = GetTransform(shared.key.first, shared.key.second, shared.transform);
+
+    if (geometry_renderer_)
+    {
+      if (shared.id == 0)
+      {
+        shared.id = geometry_renderer_->CreateTransform(this);
+      }
+      geometry_renderer_->UpdateTransform(
+          shared.id,
+          tf::Transform(shared.transform.GetOrientation(), shared.transform.GetOrigin()));
+    }
   }
 
-  void MarkerPlugin::PrintInfo(const std::string& message)
+  /**
+   * Stores the transform from a marker's source frame to the target frame.
+   * If that changes whether the marker's vertices are in the source frame
+   * or the target frame, they are marked to be rebuilt.
+   */
+  void MarkerPlugin::setTransform(const MarkerId& id,
+                                  MarkerData& markerData,
+                                  const swri_transform_util::Transform& transform)
   {
-    PrintInfoHelper(ui_.status, message);
+    markerData.transform = transform;
+    markerData.matrix = tf::Transform(transform.GetOrientation(), transform.GetOrigin());
+
+    // Transforms to or from WGS84 can't be expressed as a matrix.
+    bool rigid =
+        !swri_transform_util::FrameIdsEqual(markerData.source_frame, swri_transform_util::_wgs84_frame) &&
+        !swri_transform_util::FrameIdsEqual(target_frame_, swri_transform_util::_wgs84_frame);
+    if (rigid && HasShapes(markerData.display_type))
+    {
+      rigid = IsLevel(markerData.matrix);
+    }
+
+    if (rigid != markerData.rigid)
+    {
+      markerData.rigid = rigid;
+      markGeometryDirty(id, markerData);
+    }
   }
 
-  void MarkerPlugin::PrintWarning(const std::string& message)
+  /**
+   * Recomputes the extent of a marker in its source frame.
+   * @param[inout] markerData A marker whose points have been set.
+   */
+  void MarkerPlugin::updateLocalBounds(MarkerData& markerData)
   {
-    PrintWarningHelper(ui_.status, message);
+    markerData.local_bounds.Clear();
+    markerData.min_z = std::numeric_limits<float>::max();
+    markerData.max_z = -std::numeric_limits<float>::max();
+    auto extend = [&markerData](const tf::Point& point)
+    {
+      markerData.local_bounds.Extend(point);
+      markerData.min_z = std::min(markerData.min_z, static_cast<float>(point.z()));
+      markerData.max_z = std::max(markerData.max_z, static_cast<float>(point.z()));
+    };
+
+    for (const auto &point : markerData.points)
+    {
+      extend(point.point);
+      if (markerData.display_type == visualization_msgs::Marker::ARROW)
+      {
+        extend(point.arrow_point);
+        extend(point.arrow_left);
+        extend(point.arrow_right);
+        // Only the first point of an arrow is meaningful
+        break;
+      }
+    }
+
+    if (markerData.min_z > markerData.max_z)
+    {
+      markerData.min_z = 0.0f;
+      markerData.max_z = 0.0f;
+    }
+
+    if (markerData.display_type == visualization_msgs::Marker::CYLINDER ||
+        markerData.display_type == visualization_msgs::Marker::SPHERE ||
+        markerData.display_type == visualization_msgs::Marker::SPHERE_LIST ||
+        markerData.display_type == visualization_msgs::Marker::CUBE_LIST)
+    {
+      markerData.local_bounds.Pad(std::max(markerData.scale_x, markerData.scale_y));
+    }
   }
 
-  QWidget* MarkerPlugin::GetConfigWidget(QWidget* parent)
+  /**
+   * Recomputes the extent of a marker in the target frame and moves it to
+   * its new place in the spatial index.
+   * @param[in] id The marker's namespace and id.
+   * @param[inout] markerData A marker whose transform has been set.
+   */
+  void MarkerPlugin::updateBounds(const MarkerId& id, MarkerData& markerData)
   {
-    config_widget_->setParent(parent);
+    if (!markerData.transformed)
+    {
+      markerData.bounds.Clear();
+      marker_index_.Remove(id);
+      return;
+    }
 
-    return config_widget_;
+    if (markerData.rigid)
+    {
+      markerData.bounds = markerData.local_bounds.Transformed(
+          markerData.matrix, markerData.min_z, markerData.max_z);
+    }
+    else
+    {
+      markerData.bounds.Clear();
+      for (const auto &point : markerData.points)
+      {
+        markerData.bounds.Extend(markerData.transform * point.point);
+        if (markerData.display_type == visualization_msgs::Marker::ARROW)
+        {
+          markerData.bounds.Extend(markerData.transform * point.arrow_point);
+          markerData.bounds.Extend(markerData.transform * point.arrow_left);
+          markerData.bounds.Extend(markerData.transform * point.arrow_right);
+          break;
+        }
+      }
+
+      if (markerData.display_type == visualization_msgs::Marker::CYLINDER ||
+          markerData.display_type == visualization_msgs::Marker::SPHERE ||
+          markerData.display_type == visualization_msgs::Marker::SPHERE_LIST ||
+          markerData.display_type == visualization_msgs::Marker::CUBE_LIST)
+      {
+        markerData.bounds.Pad(std::max(markerData.scale_x, markerData.scale_y));
+      }
+    }
+
+    marker_index_.Insert(id, markerData.bounds);
   }
 
-  bool MarkerPlugin::Initialize(QGLWidget* canvas)
+  void MarkerPlugin::markGeometryDirty(const MarkerId& id, MarkerData& markerData)
   {
-    canvas_ = canvas;
+    if (!markerData.geometry_dirty)
+    {
+      markerData.geometry_dirty = true;
+      dirty_markers_.push_back(id);
+    }
+  }
 
-    return true;
+  /**
+   * Hashes every field of a marker that its points and geometry depend on.
+   * The stamp and lifetime are left out, since they change from one message
+   * to the next without changing what is drawn.
+   */
+  std::size_t MarkerPlugin::HashMarker(const visualization_msgs::Marker& marker)
+  {
+    std::size_t seed = 0;
+    boost::hash_combine(seed, marker.type);
+    boost::hash_combine(seed, marker.header.frame_id);
+    boost::hash_combine(seed, marker.pose.position.x);
+    boost::hash_combine(seed, marker.pose.position.y);
+    boost::hash_combine(seed, marker.pose.position.z);
+    boost::hash_combine(seed, marker.pose.orientation.x);
+    boost::hash_combine(seed, marker.pose.orientation.y);
+    boost::hash_combine(seed, marker.pose.orientation.z);
+    boost::hash_combine(seed, marker.pose.orientation.w);
+    boost::hash_combine(seed, marker.scale.x);
+    boost::hash_combine(seed, marker.scale.y);
+    boost::hash_combine(seed, marker.scale.z);
+    boost::hash_combine(seed, marker.color.r);
+    boost::hash_combine(seed, marker.color.g);
+    boost::hash_combine(seed, marker.color.b);
+    boost::hash_combine(seed, marker.color.a);
+    boost::hash_combine(seed, marker.text);
+    for (const auto& point : marker.points)
+    {
+      boost::hash_combine(seed, point.x);
+      boost::hash_combine(seed, point.y);
+      boost::hash_combine(seed, point.z);
+    }
+    for (const auto& color : marker.colors)
+    {
+      boost::hash_combine(seed, color.r);
+      boost::hash_combine(seed, color.g);
+      boost::hash_combine(seed, color.b);
+      boost::hash_combine(seed, color.a);
+    }
+    return seed;
   }
 
-  void MarkerPlugin::Draw(double x, double y, double scale)
+  mapviz::GeometryRenderer::Vertex MarkerPlugin::makeVertex(const tf::Point& point, const Color& color)
+  {
+    mapviz::GeometryRenderer::Vertex vertex;
+    vertex.x = static_cast<float>(point.x());
+    vertex.y = static_cast<float>(point.y());
+    vertex.z = static_cast<float>(point.z());
+    vertex.u = 0.0f;
+    vertex.v = 0.0f;
+    vertex.color[0] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, color.r)) * 255.0f + 0.5f);
+    vertex.color[1] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, color.g)) * 255.0f + 0.5f);
+    vertex.color[2] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, color.b)) * 255.0f + 0.5f);
+    vertex.color[3] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, color.a)) * 255.0f + 0.5f);
+    return vertex;
+  }
+
+  /**
+   * Rebuilds the vertices of a marker and hands them to the geometry
+   * renderer.  Vertices are in the marker's source frame unless its
+   * transform isn't rigid, in which case they are in the target frame.
+   */
+  void MarkerPlugin::updateGeometry(const MarkerId& id, MarkerData& markerData)
   {
-    for (size_t i = 0; i < ui_.nsList->count(); i++)
+    markerData.geometry_dirty = false;
+
+    if (use_instancing_ && IsInstanceable(markerData.display_type))
+    {
+      if (geometry_renderer_ && markerData.geometry != 0)
+      {
+        geometry_renderer_->Remove(markerData.geometry);
+        markerData.geometry = 0;
+      }
+      updateInstances(id, markerData);
+      return;
+    }
+
+    // The marker may have been a list before it was added again
+    releaseInstances(id, markerData);
+
+    if (!geometry_renderer_)
+    {
+      return;
+    }
+
+    // Vertices in the source frame keep their z, since the matrix may
+    // rotate it into x and y; in the target frame it isn't needed.
+    const bool in_target_frame = !markerData.rigid;
+    auto toVertex = [&](const tf::Point& point, const Color& color)
     {
-      if (ui_.nsList->item(i)->checkState() == Qt::Checked)
+      if (in_target_frame)
       {
-        marker_visible_[ui_.nsList->item(i)->text().toStdString()] = true;
+        tf::Point transformed = markerData.transform * point;
+        transformed.setZ(0.0);
+        return makeVertex(transformed, color);
+      }
+      return makeVertex(point, color);
+    };
+
+    mapviz::GeometryRenderer::Style style;
+    vertices_.clear();
+
+    if (markerData.display_type == visualization_msgs::Marker::ARROW && !markerData.points.empty())
+    {
+      // If the marker only has one point, use scale_y as the arrow width.
+      // If the marker has both start and end points explicitly specified, use
+      // scale_x as the shaft diameter.
+      style.primitive = mapviz::GeometryRenderer::LINES;
+      style.size = markerData.points.size() == 1 ? markerData.scale_y : markerData.scale_x;
+
+      const StampedPoint& point = markerData.points.front();
+      vertices_.push_back(toVertex(point.point, point.color));
+      vertices_.push_back(toVertex(point.arrow_point, point.color));
+      vertices_.push_back(toVertex(point.arrow_point, point.color));
+      vertices_.push_back(toVertex(point.arrow_left, point.color));
+      vertices_.push_back(toVertex(point.arrow_point, point.color));
+      vertices_.push_back(toVertex(point.arrow_right, point.color));
+    }
+    else if (markerData.display_type == visualization_msgs::Marker::LINE_STRIP ||
+             markerData.display_type == visualization_msgs::Marker::LINE_LIST ||
+             markerData.display_type == visualization_msgs::Marker::POINTS ||
+             markerData.display_type == visualization_msgs::Marker::TRIANGLE_LIST)
+    {
+      if (markerData.display_type == visualization_msgs::Marker::LINE_STRIP)
+      {
+        style.primitive = mapviz::GeometryRenderer::LINE_STRIP;
+      }
+      else if (markerData.display_type == visualization_msgs::Marker::LINE_LIST)
+      {
+        style.primitive = mapviz::GeometryRenderer::LINES;
+      }
+      else if (markerData.display_type == visualization_msgs::Marker::POINTS)
+      {
+        style.primitive = mapviz::GeometryRenderer::POINTS;
       }
       else
       {
-        marker_visible_[ui_.nsList->item(i)->text().toStdString()] = false;
+        style.primitive = mapviz::GeometryRenderer::TRIANGLES;
+      }
+      style.size = markerData.scale_x;
+
+      vertices_.reserve(markerData.points.size());
+      for (const auto &point : markerData.points)
+      {
+        vertices_.push_back(toVertex(point.point, point.color));
       }
     }
+    else if (markerData.display_type == visualization_msgs::Marker::CYLINDER ||
+             markerData.display_type == visualization_msgs::Marker::SPHERE ||
+             markerData.display_type == visualization_msgs::Marker::SPHERE_LIST)
+    {
+      style.primitive = mapviz::GeometryRenderer::TRIANGLES;
 
-    ros::Time now = ros::Time::now();
+      // Spheres may be specified w/ only one scale value
+      const double radius_x = markerData.scale_x;
+      const double radius_y = markerData.scale_y == 0.0 ? markerData.scale_x : markerData.scale_y;
 
-    auto markerIter = markers_.begin();
-    while (markerIter != markers_.end())
+      vertices_.reserve(markerData.points.size() * CIRCLE_SEGMENTS * 3);
+      for (const auto &point : markerData.points)
+      {
+        for (int32_t i = 0; i < CIRCLE_SEGMENTS; i++)
+        {
+          const double start = 2.0 * M_PI * i / CIRCLE_SEGMENTS;
+          const double end = 2.0 * M_PI * (i + 1) / CIRCLE_SEGMENTS;
+          vertices_.push_back(toVertex(point.point, point.color));
+          vertices_.push_back(toVertex(point.point + tf::Vector3(
+              std::sin(start) * radius_x, std::cos(start) * radius_y, 0.0), point.color));
+          vertices_.push_back(toVertex(point.point + tf::Vector3(
+              std::sin(end) * radius_x, std::cos(end) * radius_y, 0.0), point.color));
+        }
+      }
+    }
+    else if (markerData.display_type == visualization_msgs::Marker::CUBE && markerData.points.size() == 4)
     {
-      MarkerData& marker = markerIter->second;
+      style.primitive = mapviz::GeometryRenderer::TRIANGLES;
+      mapviz::GeometryRenderer::AppendQuad(
+          vertices_,
+          toVertex(markerData.points[0].point, markerData.points[0].color),
+          toVertex(markerData.points[1].point, markerData.points[1].color),
+          toVertex(markerData.points[2].point, markerData.points[2].color),
+          toVertex(markerData.points[3].point, markerData.points[3].color));
+    }
+    else if (markerData.display_type == visualization_msgs::Marker::CUBE_LIST)
+    {
+      style.primitive = mapviz::GeometryRenderer::TRIANGLES;
 
-      if (!(marker.expire_time > now)) {
-        PrintInfo("OK");
-        markerIter = markers_.erase(markerIter);
-        continue;
+      const double half_x = markerData.scale_x / 2.0;
+      const double half_y = markerData.scale_y / 2.0;
+      vertices_.reserve(markerData.points.size() * 6);
+      for (const auto &point : markerData.points)
+      {
+        mapviz::GeometryRenderer::AppendQuad(
+            vertices_,
+            toVertex(point.point + tf::Vector3(-half_x, half_y, 0.0), point.color),
+            toVertex(point.point + tf::Vector3(half_x, half_y, 0.0), point.color),
+            toVertex(point.point + tf::Vector3(half_x, -half_y, 0.0), point.color),
+            toVertex(point.point + tf::Vector3(-half_x, -half_y, 0.0), point.color));
       }
+    }
 
-      if (!marker.transformed) {
-        markerIter++;
-        continue;
+    if (markerData.geometry == 0)
+    {
+      if (vertices_.empty())
+      {
+        // Text is drawn by Paint()
+        return;
       }
+      markerData.geometry = geometry_renderer_->Create(this, style);
+    }
+    else
+    {
+      geometry_renderer_->SetStyle(markerData.geometry, style);
+    }
+    geometry_renderer_->SetVertices(markerData.geometry, vertices_);
+    updateGeometryTransform(markerData);
+  }
+
+  /**
+   * Compiles the instancing shader and fills the buffer of unit shapes.
+   * Must be called with the GL context current.
+   * @return False if the GL doesn't support instancing.
+   */
+  bool MarkerPlugin::initInstancing()
+  {
+    if (!QGLShaderProgram::hasOpenGLShaderPrograms(canvas_->context()) ||
+        !GLEW_ARB_instanced_arrays ||
+        !GLEW_ARB_draw_instanced)
+    {
+      return false;
+    }
+
+    // Each vertex of the unit shape is scaled and moved to the instance's
+    // center; the marker's transform is on the modelview matrix.
+    const char* vertex_shader =
+        "attribute vec2 shape;\n"
+        "attribute vec3 center;\n"
+        "attribute vec2 size;\n"
+        "attribute vec4 color;\n"
+        "void main()\n"
+        "{\n"
+        "  gl_FrontColor = color;\n"
+        "  gl_Position = gl_ModelViewProjectionMatrix * vec4(center + vec3(shape * size, 0.0), 1.0);\n"
+        "}\n";
+    const char* fragment_shader =
+        "void main()\n"
+        "{\n"
+        "  gl_FragColor = gl_Color;\n"
+        "}\n";
+
+    instance_program_.reset(new QGLShaderProgram(canvas_->context()));
+    // Some drivers only draw if generic attribute 0 is enabled.
+    instance_program_->bindAttributeLocation("shape", 0);
+    if (!instance_program_->addShaderFromSourceCode(QGLShader::Vertex, vertex_shader) ||
+        !instance_program_->addShaderFromSourceCode(QGLShader::Fragment, fragment_shader) ||
+        !instance_program_->link())
+    {
+      ROS_WARN("Falling back to non-instanced list markers: %s",
+               instance_program_->log().toStdString().c_str());
+      instance_program_.reset();
+      return false;
+    }
+
+    std::vector<float> shapes;
+    shapes.reserve((SQUARE_COUNT + CIRCLE_COUNT + POINT_COUNT) * 2);
+
+    // Unit square centered on the origin
+    const float square[] = {-0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f,
+                            -0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f};
+    shapes.insert(shapes.end(), square, square + SQUARE_COUNT * 2);
 
-      if (!marker_visible_[markerIter->first.first])
+    // Circle with a radius of 1
+    for (int32_t i = 0; i < CIRCLE_SEGMENTS; i++)
+    {
+      const double start = 2.0 * M_PI * i / CIRCLE_SEGMENTS;
+      const double end = 2.0 * M_PI * (i + 1) / CIRCLE_SEGMENTS;
+      shapes.push_back(0.0f);
+      shapes.push_back(0.0f);
+      shapes.push_back(static_cast<float>(std::sin(start)));
+      shapes.push_back(static_cast<float>(std::cos(start)));
+      shapes.push_back(static_cast<float>(std::sin(end)));
+      shapes.push_back(static_cast<float>(std::cos(end)));
+    }
+
+    // Point
+    shapes.push_back(0.0f);
+    shapes.push_back(0.0f);
+
+    glGenBuffers(1, &shape_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, shape_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, shapes.size() * sizeof(float), shapes.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return true;
+  }
+
+  /**
+   * Uploads the elements of a list marker for instanced drawing.  Must be
+   * called with the GL context current.
+   */
+  void MarkerPlugin::updateInstances(const MarkerId& id, MarkerData& markerData)
+  {
+    float size_x = markerData.scale_x;
+    float size_y = markerData.scale_y;
+    if (markerData.display_type == visualization_msgs::Marker::SPHERE_LIST && size_y == 0.0f)
+    {
+      // Spheres may be specified w/ only one scale value
+      size_y = size_x;
+    }
+
+    instances_.clear();
+    instances_.reserve(markerData.points.size());
+    for (const auto &point : markerData.points)
+    {
+      tf::Point center = point.point;
+      if (!markerData.rigid)
       {
-        markerIter++;
-        continue;
+        center = markerData.transform * center;
+        center.setZ(0.0);
       }
+      const mapviz::GeometryRenderer::Vertex vertex = makeVertex(center, point.color);
+
+      Instance instance;
+      instance.x = vertex.x;
+      instance.y = vertex.y;
+      instance.z = vertex.z;
+      instance.size_x = size_x;
+      instance.size_y = size_y;
+      std::copy(vertex.color, vertex.color + 4, instance.color);
+      instances_.push_back(instance);
+    }
 
-      glColor4f(marker.color.r, marker.color.g, marker.color.b, marker.color.a);
+    if (markerData.instance_buffer == 0)
+    {
+      glGenBuffers(1, &markerData.instance_buffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, markerData.instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, instances_.size() * sizeof(Instance), instances_.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-      if (marker.display_type == visualization_msgs::Marker::ARROW) {
-        if (marker.points.size() == 1) {
-          // If the marker only has one point, use scale_y as the arrow width.
-          glLineWidth(marker.scale_y);
-        }
-        else {
-          // If the marker has both start and end points explicitly specified, use
-          // scale_x as the shaft diameter.
-          glLineWidth(marker.scale_x);
-        }
-        glBegin(GL_LINES);
-
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
-
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
-          glVertex2d(
-            point.transformed_arrow_point.getX(),
-            point.transformed_arrow_point.getY());
-          glVertex2d(
-            point.transformed_arrow_point.getX(),
-            point.transformed_arrow_point.getY());
-          glVertex2d(
-            point.transformed_arrow_left.getX(),
-            point.transformed_arrow_left.getY());
-          glVertex2d(
-            point.transformed_arrow_point.getX(),
-            point.transformed_arrow_point.getY());
-          glVertex2d(
-            point.transformed_arrow_right.getX(),
-            point.transformed_arrow_right.getY());
-        }
+    markerData.instance_count = static_cast<GLsizei>(instances_.size());
+    instanced_markers_.insert(id);
+  }
 
-        glEnd();
-      }
-      else if (marker.display_type == visualization_msgs::Marker::LINE_STRIP) {
-        glLineWidth(marker.scale_x);
-        glBegin(GL_LINE_STRIP);
+  void MarkerPlugin::releaseInstances(const MarkerId& id, MarkerData& markerData)
+  {
+    if (markerData.instance_buffer != 0)
+    {
+      unused_buffers_.push_back(markerData.instance_buffer);
+      markerData.instance_buffer = 0;
+      markerData.instance_count = 0;
+    }
+    instanced_markers_.erase(id);
+  }
 
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
+  /**
+   * Draws every visible instanced list marker with one call each.
+   */
+  void MarkerPlugin::drawInstances()
+  {
+    if (instanced_markers_.empty())
+    {
+      return;
+    }
 
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
-        }
+    const int center = instance_program_->attributeLocation("center");
+    const int size = instance_program_->attributeLocation("size");
+    const int color = instance_program_->attributeLocation("color");
 
-        glEnd();
+    instance_program_->bind();
+
+    glBindBuffer(GL_ARRAY_BUFFER, shape_buffer_);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glEnableVertexAttribArray(center);
+    glEnableVertexAttribArray(size);
+    glEnableVertexAttribArray(color);
+    glVertexAttribDivisorARB(center, 1);
+    glVertexAttribDivisorARB(size, 1);
+    glVertexAttribDivisorARB(color, 1);
+
+    for (const MarkerId& id : instanced_markers_)
+    {
+      auto markerIter = markers_.find(id);
+      if (markerIter == markers_.end())
+      {
+        continue;
       }
-      else if (marker.display_type == visualization_msgs::Marker::LINE_LIST) {
-        glLineWidth(marker.scale_x);
-        glBegin(GL_LINES);
 
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
+      const MarkerData& marker = markerIter->second;
+      if (!marker.transformed ||
+          marker.instance_count == 0 ||
+          !namespace_visible_[marker.ns_id] ||
+          !draw_context_.IsVisible(marker.bounds))
+      {
+        continue;
+      }
 
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
-        }
+      glBindBuffer(GL_ARRAY_BUFFER, marker.instance_buffer);
+      glVertexAttribPointer(center, 3, GL_FLOAT, GL_FALSE, sizeof(Instance),
+          reinterpret_cast<const GLvoid*>(offsetof(Instance, x)));
+      glVertexAttribPointer(size, 2, GL_FLOAT, GL_FALSE, sizeof(Instance),
+          reinterpret_cast<const GLvoid*>(offsetof(Instance, size_x)));
+      glVertexAttribPointer(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance),
+          reinterpret_cast<const GLvoid*>(offsetof(Instance, color)));
 
-        glEnd();
+      if (marker.rigid)
+      {
+        double matrix[16];
+        mapviz::GetPlanarGLMatrix(marker.matrix, matrix);
+        glPushMatrix();
+        glMultMatrixd(matrix);
       }
-      else if (marker.display_type == visualization_msgs::Marker::POINTS) {
+
+      if (marker.display_type == visualization_msgs::Marker::POINTS)
+      {
         glPointSize(marker.scale_x);
-        glBegin(GL_POINTS);
+        glDrawArraysInstancedARB(GL_POINTS, POINT_FIRST, POINT_COUNT, marker.instance_count);
+      }
+      else if (marker.display_type == visualization_msgs::Marker::SPHERE_LIST)
+      {
+        glDrawArraysInstancedARB(GL_TRIANGLES, CIRCLE_FIRST, CIRCLE_COUNT, marker.instance_count);
+      }
+      else
+      {
+        glDrawArraysInstancedARB(GL_TRIANGLES, SQUARE_FIRST, SQUARE_COUNT, marker.instance_count);
+      }
 
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
+      if (marker.rigid)
+      {
+        glPopMatrix();
+      }
+    }
 
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
-        }
+    // Divisors are part of the attribute state, so put them back for
+    // whoever uses these attributes next.
+    glVertexAttribDivisorARB(center, 0);
+    glVertexAttribDivisorARB(size, 0);
+    glVertexAttribDivisorARB(color, 0);
+    glDisableVertexAttribArray(color);
+    glDisableVertexAttribArray(size);
+    glDisableVertexAttribArray(center);
+    glDisableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    instance_program_->release();
+  }
+
+  /**
+   * Passes a marker's transform and visibility on to the geometry renderer.
+   */
+  void MarkerPlugin::updateGeometryTransform(MarkerData& markerData)
+  {
+    if (!geometry_renderer_ || markerData.geometry == 0)
+    {
+      return;
+    }
+
+    if (markerData.rigid && markerData.shared_transform != NULL)
+    {
+      geometry_renderer_->SetTransform(markerData.geometry, markerData.shared_transform->id);
+    }
+    else
+    {
+      geometry_renderer_->ClearTransform(markerData.geometry);
+    }
+    geometry_renderer_->SetVisible(markerData.geometry,
+        markerData.transformed && namespace_visible_[markerData.ns_id]);
+  }
 
-        glEnd();
+  void MarkerPlugin::removeMarker(const MarkerId& id)
+  {
+    auto markerIter = markers_.find(id);
+    if (markerIter == markers_.end())
+    {
+      return;
+    }
+
+    if (geometry_renderer_ && markerIter->second.geometry != 0)
+    {
+      geometry_renderer_->Remove(markerIter->second.geometry);
+    }
+    releaseInstances(id, markerIter->second);
+    releaseTransform(markerIter->second);
+    marker_index_.Remove(id);
+    markers_.erase(markerIter);
+  }
+
+  void MarkerPlugin::clearMarkers()
+  {
+    if (geometry_renderer_)
+    {
+      geometry_renderer_->RemoveAll(this);
+    }
+    for (auto& marker : markers_)
+    {
+      releaseInstances(marker.first, marker.second);
+    }
+    markers_.clear();
+    // RemoveAll() took the shared transforms out of the geometry renderer
+    shared_transforms_.clear();
+    marker_index_.Clear();
+    expiry_queue_.Clear();
+    dirty_markers_.clear();
+    hovering_marker_ = false;
+  }
+
+  /**
+   * Removes every marker whose lifetime has run out.
+   */
+  void MarkerPlugin::removeExpiredMarkers(const ros::Time& now)
+  {
+    MarkerId id;
+    ros::Time expire_time;
+    while (expiry_queue_.PopExpired(now, id, expire_time))
+    {
+      // Markers that were deleted or added again since this entry was made
+      // are either gone or have a different expiration time.
+      auto markerIter = markers_.find(id);
+      if (markerIter != markers_.end() && markerIter->second.expire_time == expire_time)
+      {
+        removeMarker(id);
+        printStatus();
       }
-      else if (marker.display_type == visualization_msgs::Marker::TRIANGLE_LIST) {
-        glBegin(GL_TRIANGLES);
+    }
 
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
+    // Markers that are added again over and over leave behind entries that
+    // are out of date, so start over once they outnumber the markers.
+    if (expiry_queue_.Size() > 2 * markers_.size() + EXPIRY_QUEUE_SLACK)
+    {
+      expiry_queue_.Clear();
+      for (const auto& marker : markers_)
+      {
+        expiry_queue_.Push(marker.first, marker.second.expire_time);
+      }
+    }
+  }
 
-          glVertex2d(
-            point.transformed_point.getX(),
-            point.transformed_point.getY());
-        }
+  /**
+   * Fills queried_markers_ with the markers in a region of the target frame,
+   * or with every marker if the region is empty.
+   */
+  void MarkerPlugin::queryMarkers(const mapviz::BoundingBox& region)
+  {
+    queried_markers_.clear();
+    if (region.Empty())
+    {
+      queried_markers_.reserve(markers_.size());
+      for (const auto& marker : markers_)
+      {
+        queried_markers_.push_back(marker.first);
+      }
+    }
+    else
+    {
+      marker_index_.Query(region, queried_markers_);
+    }
+  }
 
-        glEnd();
+  /**
+   * Finds the visible marker closest to a point in the target frame.
+   * @param[in] x, y The point.
+   * @param[in] tolerance How far from a line or point a marker may be picked.
+   * @param[out] id The marker that was found.
+   * @return True if a marker was found.
+   */
+  bool MarkerPlugin::pickMarker(double x, double y, double tolerance, MarkerId& id)
+  {
+    queryMarkers(mapviz::BoundingBox(x - tolerance, y - tolerance, x + tolerance, y + tolerance));
+
+    const tf::Point pick(x, y, 0.0);
+    double best_distance = std::numeric_limits<double>::max();
+    for (const MarkerId& candidate : queried_markers_)
+    {
+      const MarkerData& marker = markers_[candidate];
+      if (!marker.transformed || !namespace_visible_[marker.ns_id])
+      {
+        continue;
       }
-      else if (marker.display_type == visualization_msgs::Marker::CYLINDER ||
-        marker.display_type == visualization_msgs::Marker::SPHERE ||
-        marker.display_type == visualization_msgs::Marker::SPHERE_LIST) {
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
 
-          glBegin(GL_TRIANGLE_FAN);
+      double distance = std::numeric_limits<double>::max();
+      if (marker.display_type == visualization_msgs::Marker::LINE_STRIP ||
+          marker.display_type == visualization_msgs::Marker::LINE_LIST)
+      {
+        // Line lists are made of pairs of points; strips of every
+        // consecutive pair.
+        const size_t step = marker.display_type == visualization_msgs::Marker::LINE_LIST ? 2 : 1;
+        for (size_t i = 0; i + 1 < marker.points.size(); i += step)
+        {
+          distance = std::min(distance, DistanceToSegment(pick,
+              marker.transform * marker.points[i].point,
+              marker.transform * marker.points[i + 1].point));
+        }
+      }
+      else if (marker.display_type == visualization_msgs::Marker::ARROW && !marker.points.empty())
+      {
+        const StampedPoint& point = marker.points.front();
+        const tf::Point base = marker.transform * point.point;
+        const tf::Point tip = marker.transform * point.arrow_point;
+        distance = std::min(
+            DistanceToSegment(pick, base, tip),
+            std::min(
+                DistanceToSegment(pick, tip, marker.transform * point.arrow_left),
+                DistanceToSegment(pick, tip, marker.transform * point.arrow_right)));
+      }
+      else if (marker.bounds.Contains(x, y))
+      {
+        distance = 0.0;
+      }
 
+      if (distance <= tolerance && distance < best_distance)
+      {
+        best_distance = distance;
+        id = candidate;
+      }
+    }
 
-          double marker_x = point.transformed_point.getX();
-          double marker_y = point.transformed_point.getY();
+    return best_distance <= tolerance;
+  }
 
-          glVertex2d(marker_x, marker_y);
+  void MarkerPlugin::Hover(double x, double y, double scale)
+  {
+    MarkerId id;
+    const bool found = Visible() && pickMarker(x, y, HOVER_TOLERANCE * scale, id);
+    if (found == hovering_marker_ && (!found || id == hover_marker_))
+    {
+      return;
+    }
 
-          for (int32_t i = 0; i <= 360; i += 10) {
-            double radians = static_cast<double>(i) * static_cast<double>(swri_math_util::_deg_2_rad);
-            // Spheres may be specified w/ only one scale value
-            if (marker.scale_y == 0.0) {
-              marker.scale_y = marker.scale_x;
-            }
-            glVertex2d(
-              marker_x + std::sin(radians) * marker.scale_x,
-              marker_y + std::cos(radians) * marker.scale_y);
-          }
+    hovering_marker_ = found;
+    hover_marker_ = id;
+    if (found)
+    {
+      QToolTip::showText(QCursor::pos(),
+          QString("%1: %2").arg(QString::fromStdString(id.first)).arg(id.second), canvas_);
+    }
+    else
+    {
+      QToolTip::hideText();
+    }
+  }
 
-          glEnd();
-        }
+  void MarkerPlugin::handleMarkerArray(const visualization_msgs::MarkerArray &markers)
+  {
+    // A DELETEALL at the start of an array is usually followed by the same
+    // markers as last time, so instead of clearing everything right away,
+    // only remove the markers that weren't added again by the end.
+    bool delete_all = false;
+    for (unsigned int i = 0; i < markers.markers.size(); i++)
+    {
+      if (markers.markers[i].action == 3) // The DELETEALL enum doesn't exist in Indigo
+      {
+        marker_generation_++;
+        delete_all = true;
+        continue;
       }
-      else if (marker.display_type == visualization_msgs::Marker::CUBE ||
-        marker.display_type == visualization_msgs::Marker::CUBE_LIST) {
-        glBegin(GL_TRIANGLE_FAN);
-        for (const auto &point : marker.points) {
-          glColor4f(point.color.r, point.color.g, point.color.b, point.color.a);
+      handleMarker(markers.markers[i]);
+    }
 
-          glVertex2d(point.transformed_point.getX(), point.transformed_point.getY());
+    if (delete_all)
+    {
+      queried_markers_.clear();
+      for (const auto& marker : markers_)
+      {
+        if (marker.second.generation != marker_generation_)
+        {
+          queried_markers_.push_back(marker.first);
         }
-        glEnd();
       }
+      for (const MarkerId& id : queried_markers_)
+      {
+        removeMarker(id);
+      }
+    }
+  }
 
-      markerIter++;
+  /**
+   * Shows how many of the recently added markers were unchanged.
+   */
+  void MarkerPlugin::printStatus()
+  {
+    if (marker_updates_ == 0)
+    {
       PrintInfo("OK");
+      return;
     }
+
+    const int hit_rate = static_cast<int>(100.0 * marker_hits_ / marker_updates_ + 0.5);
+    PrintInfo("OK (" + std::to_string(hit_rate) + "% of markers unchanged)");
+  }
+
+  void MarkerPlugin::PrintError(const std::string& message)
+  {
+    PrintErrorHelper(ui_.status, message);
+  }
+
+  void MarkerPlugin::PrintInfo(const std::string& message)
+  {
+    PrintInfoHelper(ui_.status, message);
+  }
+
+  void MarkerPlugin::PrintWarning(const std::string& message)
+  {
+    PrintWarningHelper(ui_.status, message);
+  }
+
+  QWidget* MarkerPlugin::GetConfigWidget(QWidget* parent)
+  {
+    config_widget_->setParent(parent);
+
+    return config_widget_;
+  }
+
+  bool MarkerPlugin::Initialize(QGLWidget* canvas)
+  {
+    canvas_ = canvas;
+
+    QObject::connect(canvas_, SIGNAL(Hover(double,double,double)), this, SLOT(Hover(double,double,double)));
+
+    return true;
+  }
+
+  void MarkerPlugin::Draw(double x, double y, double scale)
+  {
+    if (!instancing_checked_)
+    {
+      use_instancing_ = initInstancing();
+      instancing_checked_ = true;
+    }
+
+    removeExpiredMarkers(ros::Time::now());
+
+    if (!unused_buffers_.empty())
+    {
+      glDeleteBuffers(static_cast<GLsizei>(unused_buffers_.size()), unused_buffers_.data());
+      unused_buffers_.clear();
+    }
+
+    // Most of the markers' geometry is drawn by the geometry renderer right
+    // after this; all that's left is to rebuild what has changed since the
+    // last frame.
+    for (const MarkerId& id : dirty_markers_)
+    {
+      auto markerIter = markers_.find(id);
+      if (markerIter != markers_.end() && markerIter->second.geometry_dirty)
+      {
+        updateGeometry(markerIter->first, markerIter->second);
+      }
+    }
+    dirty_markers_.clear();
+
+    drawInstances();
+
+    printStatus();
   }
 
   void MarkerPlugin::Paint(QPainter* painter, double x, double y, double scale)
@@ -605,70 +1524,99 @@ namespace mapviz_plugins
     // and reset it; when we actually draw the text, we'll manually translate
     // it to the right place.
     QTransform tf = painter->worldTransform();
-    QFont font("Helvetica", 10);
-    painter->setFont(font);
+    painter->setFont(text_cache_.Font());
     painter->save();
     painter->resetTransform();
 
-    for (auto markerIter = markers_.begin(); markerIter != markers_.end(); ++markerIter)
+    // Labels extend to the right of and below their anchor, so look for
+    // anchors up to a screen away from the view.
+    mapviz::BoundingBox region = draw_context_.bounds;
+    region.Pad(std::max(draw_context_.width, draw_context_.height) * scale);
+    queryMarkers(region);
+
+    // When labels are decluttered, they are placed in order of their ids so
+    // that the same ones win from one frame to the next.
+    const bool declutter = ui_.declutter->isChecked();
+    if (declutter)
     {
-      MarkerData& marker = markerIter->second;
+      queried_markers_.erase(
+          std::remove_if(queried_markers_.begin(), queried_markers_.end(),
+              [this](const MarkerId& id)
+              {
+                return markers_[id].display_type != visualization_msgs::Marker::TEXT_VIEW_FACING;
+              }),
+          queried_markers_.end());
+      std::sort(queried_markers_.begin(), queried_markers_.end());
+      label_grid_.Reset(painter->viewport());
+    }
+
+    for (const MarkerId& id : queried_markers_)
+    {
+      MarkerData& marker = markers_[id];
 
       if (marker.display_type != visualization_msgs::Marker::TEXT_VIEW_FACING ||
           marker.expire_time <= now ||
-          !marker.transformed)
+          !marker.transformed ||
+          marker.points.empty())
       {
         continue;
       }
 
-      QPen pen(QBrush(QColor::fromRgbF(marker.color.r, marker.color.g,
-                             marker.color.b, marker.color.a)), 1);
-      painter->setPen(pen);
-
-      StampedPoint& rosPoint = marker.points.front();
-      QPointF point = tf.map(QPointF(rosPoint.transformed_point.x(),
-                                     rosPoint.transformed_point.y()));
+      const tf::Point rosPoint = marker.transform * marker.points.front().point;
+      QPointF point = tf.map(QPointF(rosPoint.x(), rosPoint.y()));
 
-      auto text = QString::fromStdString(marker.text);
-      // Get bounding rectangle
-      QRectF rect(point, QSizeF(10,10));
-      rect = painter->boundingRect(rect, Qt::AlignLeft | Qt::AlignHCenter, text);
-      painter->drawText(rect, text);
+      const QStaticText text = text_cache_.Get(marker.text);
+      const QRectF rect(point, text.size());
+      if (!rect.intersects(painter->viewport()) ||
+          (declutter && !label_grid_.Place(rect)))
+      {
+        continue;
+      }
 
-      PrintInfo("OK");
+      // Labels often share a color, so only switch pens when it changes
+      const QColor color = QColor::fromRgbF(marker.color.r, marker.color.g,
+                                            marker.color.b, marker.color.a);
+      if (color != painter->pen().color())
+      {
+        painter->setPen(QPen(QBrush(color), 1));
+      }
+      painter->drawStaticText(point, text);
     }
 
+    text_cache_.Trim();
     painter->restore();
   }
 
   void MarkerPlugin::Transform()
   {
+    // Each shared transform is looked up once, and its new matrix is all the
+    // geometry renderer needs for the rigid markers using it.
+    for (auto& shared : shared_transforms_)
+    {
+      lookupTransform(shared.second);
+    }
+
     for (auto markerIter = markers_.begin(); markerIter != markers_.end(); ++markerIter)
     {
       MarkerData& marker = markerIter->second;
-
-      swri_transform_util::Transform transform;
-      if (GetTransform(marker.source_frame, marker.stamp, transform))
+      if (marker.shared_transform == NULL)
       {
-        marker.transformed = true;
+        continue;
+      }
 
-        if (marker.display_type == visualization_msgs::Marker::ARROW)
-        {
-          // Points for the ARROW marker type are stored a bit differently
-          // than other types, so they have their own special transform case.
-          transformArrow(marker, transform);
-        }
-        else
-        {
-          for (auto &point : marker.points)
-          {
-            point.transformed_point = transform * (marker.local_transform * point.point);
-          }
-        }
+      marker.transformed = marker.shared_transform->valid;
+      setTransform(markerIter->first, marker, marker.shared_transform->transform);
+      updateBounds(markerIter->first, marker);
+
+      // A rigid transform only needs a new matrix; anything else means
+      // transforming every vertex again.
+      if (marker.rigid)
+      {
+        updateGeometryTransform(marker);
       }
       else
       {
-        marker.transformed = false;
+        markGeometryDirty(markerIter->first, marker);
       }
     }
   }
@@ -683,11 +1631,19 @@ namespace mapviz_plugins
 
       TopicEdited();
     }
+
+    if (node["declutter_labels"])
+    {
+      bool declutter;
+      node["declutter_labels"] >> declutter;
+      ui_.declutter->setChecked(declutter);
+    }
   }
 
   void MarkerPlugin::SaveConfig(YAML::Emitter& emitter, const std::string& path)
   {
     emitter << YAML::Key << "topic" << YAML::Value << boost::trim_copy(ui_.topic->text().toStdString());
+    emitter << YAML::Key << "declutter_labels" << YAML::Value << ui_.declutter->isChecked();
   }
 
   void MarkerPlugin::timerEvent(QTimerEvent *event)
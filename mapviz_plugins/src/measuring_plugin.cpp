@@ -354,8 +354,8 @@ void MeasuringPlugin::Paint(QPainter* painter, double x, double y, double scale)
   }
 
   QTransform tf = painter->worldTransform();
-  QFont font("Helvetica", ui_.font_size->value());
-  painter->setFont(font);
+  text_cache_.SetFont(QFont("Helvetica", ui_.font_size->value()));
+  painter->setFont(text_cache_.Font());
   painter->save();
   painter->resetTransform();
 
@@ -366,7 +366,6 @@ void MeasuringPlugin::Paint(QPainter* painter, double x, double y, double scale)
   QPen pen(QBrush(color), 1);
   painter->setPen(pen);
 
-  const QRectF qrect = QRectF(0, 0, 0, 0);
   MeasurementBox mb;
   std::vector<MeasurementBox> tags;
 
@@ -379,17 +378,16 @@ void MeasuringPlugin::Paint(QPainter* painter, double x, double y, double scale)
     mb.string.setNum(measurements_[i], 'g', 5);
     mb.string.prepend(" ");
     mb.string.append(" m ");
-    //drawText used here to get correct mb.rect size
-    painter->drawText(qrect, 0, mb.string, &mb.rect);
-    mb.rect.moveTopLeft(tf.map(QPointF((v1.x()+v2.x())/2, (v1.y()+v2.y())/2)));
+    mb.text = text_cache_.Get(mb.string);
+    mb.rect = QRectF(tf.map(QPointF((v1.x()+v2.x())/2, (v1.y()+v2.y())/2)), mb.text.size());
     tags.push_back(mb);
   }
   //(endpoint positioned) total dist
   mb.string.setNum(measurements_.back(), 'g', 5);
   mb.string.prepend(" Total: ");
   mb.string.append(" m ");
-  painter->drawText(qrect, 0, mb.string, &mb.rect);
-  mb.rect.moveTopLeft(tf.map(QPointF(vertices_.back().x(), vertices_.back().y())));
+  mb.text = text_cache_.Get(mb.string);
+  mb.rect = QRectF(tf.map(QPointF(vertices_.back().x(), vertices_.back().y())), mb.text.size());
   tags.push_back(mb);
 
   //prevent text overlapping
@@ -422,8 +420,9 @@ void MeasuringPlugin::Paint(QPainter* painter, double x, double y, double scale)
       painter->fillRect(tag.rect, color);
       painter->drawRect(tag.rect);
     }
-    painter->drawText(tag.rect, tag.string);
+    painter->drawStaticText(tag.rect.topLeft(), tag.text);
   }
+  text_cache_.Trim();
   painter->restore();
 }
 
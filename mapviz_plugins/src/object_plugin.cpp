@@ -29,6 +29,9 @@
 
 #include <mapviz_plugins/object_plugin.h>
 
+// C++ standard libraries
+#include <algorithm>
+
 #include <mapviz/select_topic_dialog.h>
 
 #include <swri_math_util/constants.h>
@@ -82,6 +85,7 @@ namespace mapviz_plugins
   void ObjectPlugin::ClearHistory()
   {
     objects_.clear();
+    object_index_.Clear();
   }
 
   void ObjectPlugin::SelectTopic()
@@ -106,6 +110,7 @@ namespace mapviz_plugins
     {
       initialized_ = false;
       objects_.clear();
+      object_index_.Clear();
       has_message_ = false;
       PrintWarning("No messages received.");
 
@@ -125,10 +130,13 @@ namespace mapviz_plugins
 
   void ObjectPlugin::handleMessage(const topic_tools::ShapeShifter::ConstPtr& msg)
   {
+    RequestRedraw();
+
     connected_ = true;
     if (IS_INSTANCE(msg, marti_nav_msgs::TrackedObjectArray))
     {
       objects_.clear();
+      object_index_.Clear();
 
       auto objs = msg->instantiate<marti_nav_msgs::TrackedObjectArray>();
       objects_.reserve(objs->objects.size());
@@ -140,6 +148,7 @@ namespace mapviz_plugins
     else if (IS_INSTANCE(msg, marti_nav_msgs::ObstacleArray))
     {
       objects_.clear();
+      object_index_.Clear();
 
       auto objs = msg->instantiate<marti_nav_msgs::ObstacleArray>();
       objects_.reserve(objs->obstacles.size());
@@ -208,6 +217,7 @@ namespace mapviz_plugins
       data.polygon.push_back(data.polygon.front());
     }
     objects_.push_back(data);
+    updateBounds(objects_.size() - 1);
   }
 
   void ObjectPlugin::handleTrack(const marti_nav_msgs::TrackedObject &obj)
@@ -264,6 +274,50 @@ namespace mapviz_plugins
       data.polygon.push_back(data.polygon.front());
     }
     objects_.push_back(data);
+    updateBounds(objects_.size() - 1);
+  }
+
+  /**
+   * Recomputes the extent of an object from its transformed polygon and
+   * moves it to its new place in the spatial index.
+   */
+  void ObjectPlugin::updateBounds(size_t index)
+  {
+    ObjectData& data = objects_[index];
+    data.bounds.Clear();
+    for (const auto& point : data.polygon)
+    {
+      data.bounds.Extend(point.transformed_point);
+    }
+
+    if (data.transformed)
+    {
+      object_index_.Insert(index, data.bounds);
+    }
+    else
+    {
+      object_index_.Remove(index);
+    }
+  }
+
+  /**
+   * Fills queried_objects_ with the objects in a region of the target frame,
+   * or with every object if the region is empty.
+   */
+  void ObjectPlugin::queryObjects(const mapviz::BoundingBox& region)
+  {
+    queried_objects_.clear();
+    if (region.Empty())
+    {
+      for (size_t i = 0; i < objects_.size(); i++)
+      {
+        queried_objects_.push_back(i);
+      }
+    }
+    else
+    {
+      object_index_.Query(region, queried_objects_);
+    }
   }
 
   void ObjectPlugin::PrintError(const std::string& message)
@@ -298,8 +352,14 @@ namespace mapviz_plugins
 
   void ObjectPlugin::Draw(double x, double y, double scale)
   {
-    for (const auto& obj: objects_)
+    // Pad the view by the line width
+    mapviz::BoundingBox region = draw_context_.bounds;
+    region.Pad(3.0 * scale);
+    queryObjects(region);
+
+    for (size_t index: queried_objects_)
     {
+      const ObjectData& obj = objects_[index];
       if (!obj.transformed)
       {
         continue;
@@ -344,9 +404,16 @@ namespace mapviz_plugins
     painter->save();
     painter->resetTransform();
 
-    for (const auto& obj: objects_)
+    // Labels extend to the right of and below their anchor, so look for
+    // objects up to a screen away from the view.
+    mapviz::BoundingBox region = draw_context_.bounds;
+    region.Pad(std::max(draw_context_.width, draw_context_.height) * scale);
+    queryObjects(region);
+
+    for (size_t index: queried_objects_)
     {
-      if (!obj.transformed)
+      const ObjectData& obj = objects_[index];
+      if (!obj.transformed || obj.polygon.empty())
       {
         continue;
       }
@@ -372,8 +439,9 @@ namespace mapviz_plugins
 
   void ObjectPlugin::Transform()
   {
-    for (auto& obj: objects_)
+    for (size_t index = 0; index < objects_.size(); index++)
     {
+      ObjectData& obj = objects_[index];
       swri_transform_util::Transform transform;
       if (GetTransform(obj.source_frame, obj.stamp, transform))
       {
@@ -388,6 +456,7 @@ namespace mapviz_plugins
       {
         obj.transformed = false;
       }
+      updateBounds(index);
     }
   }
 
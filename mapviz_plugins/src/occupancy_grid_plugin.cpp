@@ -33,6 +33,7 @@
 #include <GL/glut.h>
 
 // C++ standard libraries
+#include <algorithm>
 #include <cstdio>
 #include <vector>
 
@@ -49,6 +50,7 @@ PLUGINLIB_EXPORT_CLASS(mapviz_plugins::OccupancyGridPlugin, mapviz::MapvizPlugin
 namespace mapviz_plugins
 {
   const int CHANNELS = 4;
+  const int TILE_SIZE = 512;
 
   typedef std::array<uchar, 256*4> Palette;
 
@@ -150,7 +152,13 @@ namespace mapviz_plugins
   OccupancyGridPlugin::OccupancyGridPlugin() :
     config_widget_(new QWidget()),
     transformed_(false),
-    texture_id_(0),
+    tiles_x_(0),
+    grid_width_(0),
+    grid_height_(0),
+    palette_texture_id_(0),
+    palette_dirty_(true),
+    shader_checked_(false),
+    use_shader_(false),
     map_palette_( makeMapPalette() ),
     costmap_palette_( makeCostmapPalette() )
   {
@@ -176,6 +184,8 @@ namespace mapviz_plugins
 
     QObject::connect(ui_.color_scheme, SIGNAL(currentTextChanged(const QString &)), this, SLOT(colorSchemeUpdated(const QString &)));
 
+    QObject::connect(ui_.alpha, SIGNAL(valueChanged(double)), this, SLOT(alphaChanged(double)));
+
     PrintWarning("waiting for first message");
   }
 
@@ -186,6 +196,28 @@ namespace mapviz_plugins
 
   void OccupancyGridPlugin::Shutdown()
   {
+    for (Tile& tile: tiles_)
+    {
+      if (tile.texture_id != 0)
+      {
+        glDeleteTextures(1, &tile.texture_id);
+        tile.texture_id = 0;
+        tile.allocated = false;
+      }
+    }
+    if (!stale_textures_.empty())
+    {
+      glDeleteTextures(stale_textures_.size(), stale_textures_.data());
+      stale_textures_.clear();
+    }
+    if (palette_texture_id_ != 0)
+    {
+      glDeleteTextures(1, &palette_texture_id_);
+      palette_texture_id_ = 0;
+      palette_dirty_ = true;
+    }
+    palette_program_.reset();
+    shader_checked_ = false;
   }
 
   void OccupancyGridPlugin::DrawIcon()
@@ -239,6 +271,7 @@ namespace mapviz_plugins
     initialized_ = false;
     grid_.reset();
     raw_buffer_.clear();
+    DataChanged();
 
     grid_sub_.shutdown();
     update_sub_.shutdown();
@@ -267,24 +300,20 @@ namespace mapviz_plugins
 
   void OccupancyGridPlugin::colorSchemeUpdated(const QString &)
   {
+    // With the palette shader only the 1 KB palette is re-sent; otherwise
+    // the whole grid is recolored when the texture is next updated.
+    palette_dirty_ = true;
+    DataChanged();
+  }
 
-    if( grid_ && raw_buffer_.size()>0)
-    {
-      const size_t width  = grid_->info.width;
-      const size_t height = grid_->info.height;
-      const Palette& palette = (ui_.color_scheme->currentText() == "map") ?  map_palette_ : costmap_palette_;
+  void OccupancyGridPlugin::alphaChanged(double)
+  {
+    DataChanged();
+  }
 
-      for (size_t row = 0; row < height;  row++)
-      {
-        for (size_t col = 0; col < width; col++)
-        {
-          size_t index = (col + row * texture_size_);
-          uchar color = raw_buffer_[index];
-          memcpy( &color_buffer_[index*CHANNELS], &palette[color*CHANNELS], CHANNELS);
-        }
-      }
-      updateTexture();
-    }
+  const OccupancyGridPlugin::Palette& OccupancyGridPlugin::currentPalette() const
+  {
+    return (ui_.color_scheme->currentText() == "map") ?  map_palette_ : costmap_palette_;
   }
 
   void OccupancyGridPlugin::PrintError(const std::string& message)
@@ -316,45 +345,218 @@ namespace mapviz_plugins
     return true;
   }
 
-  void OccupancyGridPlugin::updateTexture()
+  bool OccupancyGridPlugin::initPaletteShader()
   {
-    if (texture_id_ != -1)
+    if (!QGLShaderProgram::hasOpenGLShaderPrograms(canvas_->context()))
+    {
+      return false;
+    }
+
+    // The grid texture holds the raw cell values; each one is looked up in
+    // the 256 x 1 palette texture.
+    const char* vertex_shader =
+        "varying vec2 tex_coord;\n"
+        "void main()\n"
+        "{\n"
+        "  tex_coord = gl_MultiTexCoord0.st;\n"
+        "  gl_FrontColor = gl_Color;\n"
+        "  gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+        "}\n";
+    const char* fragment_shader =
+        "uniform sampler2D grid;\n"
+        "uniform sampler2D palette;\n"
+        "varying vec2 tex_coord;\n"
+        "void main()\n"
+        "{\n"
+        "  float value = texture2D(grid, tex_coord).r * 255.0;\n"
+        "  gl_FragColor = texture2D(palette, vec2((value + 0.5) / 256.0, 0.5)) * gl_Color;\n"
+        "}\n";
+
+    palette_program_.reset(new QGLShaderProgram(canvas_->context()));
+    if (!palette_program_->addShaderFromSourceCode(QGLShader::Vertex, vertex_shader) ||
+        !palette_program_->addShaderFromSourceCode(QGLShader::Fragment, fragment_shader) ||
+        !palette_program_->link())
     {
-      glDeleteTextures(1, &texture_id_);
+      ROS_WARN("Falling back to CPU occupancy grid coloring: %s",
+               palette_program_->log().toStdString().c_str());
+      palette_program_.reset();
+      return false;
     }
 
-    // Get a new texture id.
-    glGenTextures(1, &texture_id_);
+    return true;
+  }
+
+  void OccupancyGridPlugin::updatePalette()
+  {
+    if (use_shader_)
+    {
+      if (palette_texture_id_ == 0)
+      {
+        glGenTextures(1, &palette_texture_id_);
+      }
 
-    // Bind the texture with the correct size and null memory.
-    glBindTexture(GL_TEXTURE_2D, texture_id_);
+      glBindTexture(GL_TEXTURE_2D, palette_texture_id_);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            GL_RGBA,
+            256,
+            1,
+            0,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            currentPalette().data());
+      glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    else
+    {
+      markDirty(QRect(0, 0, grid_width_, grid_height_));
+    }
+
+    palette_dirty_ = false;
+  }
+
+  void OccupancyGridPlugin::updateColorBuffer(const QRect& rect)
+  {
+    const size_t size = grid_width_*grid_height_*CHANNELS;
+    if (color_buffer_.size() != size)
+    {
+      color_buffer_.assign(size, 0);
+    }
+
+    const Palette& palette = currentPalette();
+    for (int row = rect.top(); row <= rect.bottom(); row++)
+    {
+      for (int col = rect.left(); col <= rect.right(); col++)
+      {
+        size_t index = (col + row * grid_width_);
+        uchar color = raw_buffer_[index];
+        memcpy( &color_buffer_[index*CHANNELS], &palette[color*CHANNELS], CHANNELS);
+      }
+    }
+  }
+
+  void OccupancyGridPlugin::markDirty(const QRect& rect)
+  {
+    if (rect.isEmpty())
+    {
+      return;
+    }
+
+    // Only the tiles the rectangle intersects are touched.
+    for (int row = rect.top() / TILE_SIZE; row <= rect.bottom() / TILE_SIZE; row++)
+    {
+      for (int col = rect.left() / TILE_SIZE; col <= rect.right() / TILE_SIZE; col++)
+      {
+        Tile& tile = tiles_[col + row * tiles_x_];
+        tile.dirty |= rect & tile.cells;
+      }
+    }
+  }
+
+  void OccupancyGridPlugin::updateTextures()
+  {
+    if (!shader_checked_)
+    {
+      use_shader_ = initPaletteShader();
+      shader_checked_ = true;
+    }
+
+    if (!stale_textures_.empty())
+    {
+      glDeleteTextures(stale_textures_.size(), stale_textures_.data());
+      stale_textures_.clear();
+    }
+
+    if (palette_dirty_)
+    {
+      updatePalette();
+    }
+  }
+
+  void OccupancyGridPlugin::updateTile(Tile& tile)
+  {
+    // With the palette shader the raw cell values are uploaded as a single
+    // channel; otherwise they are expanded to RGBA first.
+    GLenum format = GL_LUMINANCE;
+    int channels = 1;
+
+    if (tile.texture_id == 0)
+    {
+      glGenTextures(1, &tile.texture_id);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, tile.texture_id);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (!use_shader_)
+    {
+      format = GL_RGBA;
+      channels = CHANNELS;
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (!tile.allocated)
+    {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+      glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+
+      glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            format,
+            TILE_SIZE,
+            TILE_SIZE,
+            0,
+            format,
+            GL_UNSIGNED_BYTE,
+            NULL);
+
+      tile.allocated = true;
+      tile.dirty = tile.cells;
+    }
 
-    glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+    if (!tile.dirty.isEmpty())
+    {
+      const uchar* buffer = raw_buffer_.data();
+      if (!use_shader_)
+      {
+        updateColorBuffer(tile.dirty);
+        buffer = color_buffer_.data();
+      }
 
-    glTexImage2D(
-          GL_TEXTURE_2D,
-          0,
-          GL_RGBA,
-          texture_size_,
-          texture_size_,
-          0,
-          GL_RGBA,
-          GL_UNSIGNED_BYTE,
-          color_buffer_.data());
+      // Only send the cells that changed; rows of the dirty rectangle are
+      // grid_width_ apart in the buffer.
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, grid_width_);
+
+      const size_t offset = (tile.dirty.x() + tile.dirty.y() * grid_width_) * channels;
+      glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            tile.dirty.x() - tile.cells.x(),
+            tile.dirty.y() - tile.cells.y(),
+            tile.dirty.width(),
+            tile.dirty.height(),
+            format,
+            GL_UNSIGNED_BYTE,
+            buffer + offset);
+
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+      tile.dirty = QRect();
+    }
 
     glBindTexture(GL_TEXTURE_2D, 0);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-
   }
 
-
   void OccupancyGridPlugin::Callback(const nav_msgs::OccupancyGridConstPtr& msg)
   {
     grid_ = msg;
@@ -368,34 +570,59 @@ namespace mapviz_plugins
       PrintError("No transform between " + source_frame_ + " and " + target_frame_);
     }
 
-    int32_t max_dimension = std::max(height, width);
-
-    texture_size_ = 2;
-    while (texture_size_ < max_dimension){
-      texture_size_ = texture_size_ << 1;
+    if (grid_->data.size() < static_cast<size_t>(width*height))
+    {
+      PrintError("Grid data is smaller than its dimensions");
+      grid_.reset();
+      return;
     }
 
-    const Palette& palette = (ui_.color_scheme->currentText() == "map") ?  map_palette_ : costmap_palette_;
-
-    raw_buffer_.resize(texture_size_*texture_size_, 0);
-    color_buffer_.resize(texture_size_*texture_size_*CHANNELS, 0);
-
-    for (size_t row = 0; row < height; row++)
+    // Only rebuild the tiles when the grid dimensions change; otherwise the
+    // new grid is written over the old one in place.
+    if (width != grid_width_ || height != grid_height_ ||
+        raw_buffer_.size() != static_cast<size_t>(width*height))
     {
-      for (size_t col = 0; col < width; col++)
+      // The old textures are released in Draw(), where the GL context is
+      // current.
+      for (const Tile& tile: tiles_)
+      {
+        if (tile.texture_id != 0)
+        {
+          stale_textures_.push_back(tile.texture_id);
+        }
+      }
+      tiles_.clear();
+
+      grid_width_ = width;
+      grid_height_ = height;
+      tiles_x_ = (width + TILE_SIZE - 1) / TILE_SIZE;
+      const int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+      for (int row = 0; row < tiles_y; row++)
       {
-        size_t index_src = (col + row*width);
-        size_t index_dst = (col + row*texture_size_);
-        uchar color = static_cast<uchar>( grid_->data[ index_src ] );
-        raw_buffer_[index_dst] = color;
-        memcpy( &color_buffer_[index_dst*CHANNELS], &palette[color*CHANNELS], CHANNELS);
+        for (int col = 0; col < tiles_x_; col++)
+        {
+          Tile tile;
+          tile.cells = QRect(col * TILE_SIZE,
+                             row * TILE_SIZE,
+                             std::min(TILE_SIZE, width - col * TILE_SIZE),
+                             std::min(TILE_SIZE, height - row * TILE_SIZE));
+          tile.texture_id = 0;
+          tile.allocated = false;
+          tiles_.push_back(tile);
+        }
       }
+
+      raw_buffer_.assign(width*height, 0);
+      color_buffer_.clear();
     }
 
-    texture_x_ = static_cast<float>(width) / static_cast<float>(texture_size_);
-    texture_y_ = static_cast<float>(height) / static_cast<float>(texture_size_);
+    if (!raw_buffer_.empty())
+    {
+      memcpy( raw_buffer_.data(), grid_->data.data(), raw_buffer_.size() );
+    }
 
-    updateTexture();
+    markDirty(QRect(0, 0, width, height));
+    DataChanged();
     PrintInfo("Map received");
   }
 
@@ -403,27 +630,71 @@ namespace mapviz_plugins
   {
     PrintInfo("Update Received");
 
-    if( initialized_ )
+    if( initialized_ && grid_ )
     {
-      const Palette& palette = (ui_.color_scheme->currentText() == "map") ?  map_palette_ : costmap_palette_;
+      if (msg->x + msg->width > grid_->info.width ||
+          msg->y + msg->height > grid_->info.height)
+      {
+        PrintError("Update does not fit in the grid");
+        return;
+      }
 
       for (size_t row = 0; row < msg->height; row++)
       {
-        for (size_t col = 0; col < msg->width; col++)
-        {
-          size_t index_src = (col + row * msg->width);
-          size_t index_dst = ( (col + msg->x) + (row + msg->y)*texture_size_);
-          uchar color = static_cast<uchar>( msg->data[ index_src ] );
-          raw_buffer_[index_dst] = color;
-          memcpy( &color_buffer_[index_dst*CHANNELS], &palette[color*CHANNELS], CHANNELS);
-        }
+        size_t index_src = row * msg->width;
+        size_t index_dst = msg->x + (row + msg->y) * grid_width_;
+        memcpy( &raw_buffer_[index_dst], &msg->data[index_src], msg->width );
+      }
+      markDirty(QRect(msg->x, msg->y, msg->width, msg->height));
+      DataChanged();
+    }
+  }
+
+  /**
+   * Returns false if a rectangle of cells, in the current modelview
+   * coordinates, lies entirely outside one side of the viewport.
+   */
+  bool tileVisible(const QRect& cells, const double* modelview, const double* projection)
+  {
+    const double corners[4][2] = {
+      { static_cast<double>(cells.left()), static_cast<double>(cells.top()) },
+      { static_cast<double>(cells.left() + cells.width()), static_cast<double>(cells.top()) },
+      { static_cast<double>(cells.left()), static_cast<double>(cells.top() + cells.height()) },
+      { static_cast<double>(cells.left() + cells.width()), static_cast<double>(cells.top() + cells.height()) }
+    };
+
+    int left = 0, right = 0, below = 0, above = 0;
+    for (int i = 0; i < 4; i++)
+    {
+      // OpenGL matrices are column-major.
+      double eye[4];
+      for (int r = 0; r < 4; r++)
+      {
+        eye[r] = modelview[r] * corners[i][0] + modelview[4 + r] * corners[i][1] + modelview[12 + r];
+      }
+      double clip[4];
+      for (int r = 0; r < 4; r++)
+      {
+        clip[r] = projection[r] * eye[0] + projection[4 + r] * eye[1] +
+                  projection[8 + r] * eye[2] + projection[12 + r] * eye[3];
       }
-      updateTexture();
+
+      if (clip[0] < -clip[3]) left++;
+      if (clip[0] > clip[3]) right++;
+      if (clip[1] < -clip[3]) below++;
+      if (clip[1] > clip[3]) above++;
     }
+
+    return left < 4 && right < 4 && below < 4 && above < 4;
   }
 
   void OccupancyGridPlugin::Draw(double x, double y, double scale)
   {
+    if (grid_)
+    {
+      updateTextures();
+    }
+
     glPushMatrix();
 
     if( grid_ && transformed_)
@@ -449,33 +720,74 @@ namespace mapviz_plugins
 
       glScalef( resolution, resolution, 1.0);
 
-      float width  = static_cast<float>(grid_->info.width);
-      float height = static_cast<float>(grid_->info.height);
+      // Tiles are culled in clip space, which accounts for the grid's
+      // transform and the canvas view alike.
+      double modelview[16];
+      double projection[16];
+      glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+      glGetDoublev(GL_PROJECTION_MATRIX, projection);
 
-      glEnable(GL_TEXTURE_2D);
-      glBindTexture(GL_TEXTURE_2D, texture_id_);
-      glBegin(GL_TRIANGLES);
+      if (use_shader_)
+      {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, palette_texture_id_);
+        glActiveTexture(GL_TEXTURE0);
 
-      glColor4f(1.0f, 1.0f, 1.0f, ui_.alpha->value() );
+        palette_program_->bind();
+        palette_program_->setUniformValue("grid", 0);
+        palette_program_->setUniformValue("palette", 1);
+      }
 
-      glTexCoord2d(0, 0);
-      glVertex2d(0, 0);
-      glTexCoord2d(texture_x_, 0);
-      glVertex2d(width, 0);
-      glTexCoord2d(texture_x_, texture_y_);
-      glVertex2d(width, height);
+      glEnable(GL_TEXTURE_2D);
+      glColor4f(1.0f, 1.0f, 1.0f, ui_.alpha->value() );
 
-      glTexCoord2d(0, 0);
-      glVertex2d(0, 0);
-      glTexCoord2d(texture_x_, texture_y_);
-      glVertex2d(width, height);
-      glTexCoord2d(0, texture_y_);
-      glVertex2d(0, height);
+      for (Tile& tile: tiles_)
+      {
+        if (!tileVisible(tile.cells, modelview, projection))
+        {
+          // Changes to hidden tiles are uploaded once they come into view.
+          continue;
+        }
 
-      glEnd();
+        updateTile(tile);
+
+        const float x0 = static_cast<float>(tile.cells.left());
+        const float y0 = static_cast<float>(tile.cells.top());
+        const float x1 = x0 + static_cast<float>(tile.cells.width());
+        const float y1 = y0 + static_cast<float>(tile.cells.height());
+        const float texture_x = static_cast<float>(tile.cells.width()) / TILE_SIZE;
+        const float texture_y = static_cast<float>(tile.cells.height()) / TILE_SIZE;
+
+        glBindTexture(GL_TEXTURE_2D, tile.texture_id);
+        glBegin(GL_TRIANGLES);
+
+        glTexCoord2d(0, 0);
+        glVertex2d(x0, y0);
+        glTexCoord2d(texture_x, 0);
+        glVertex2d(x1, y0);
+        glTexCoord2d(texture_x, texture_y);
+        glVertex2d(x1, y1);
+
+        glTexCoord2d(0, 0);
+        glVertex2d(x0, y0);
+        glTexCoord2d(texture_x, texture_y);
+        glVertex2d(x1, y1);
+        glTexCoord2d(0, texture_y);
+        glVertex2d(x0, y1);
+
+        glEnd();
+      }
 
       glBindTexture(GL_TEXTURE_2D, 0);
       glDisable(GL_TEXTURE_2D);
+
+      if (use_shader_)
+      {
+        palette_program_->release();
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+      }
     }
     glPopMatrix();
   }
@@ -488,6 +800,12 @@ namespace mapviz_plugins
     {
       if( GetTransform( source_frame_, ros::Time(0), transform) )
       {
+        if (!transformed_ ||
+            transform.GetOrigin() != transform_.GetOrigin() ||
+            transform.GetOrientation() != transform_.GetOrientation())
+        {
+          DataChanged();
+        }
         transformed_ = true;
         transform_ = transform;
       }
@@ -184,6 +184,8 @@ namespace mapviz_plugins
 
   void PointDrawingPlugin::pushPoint(PointDrawingPlugin::StampedPoint stamped_point)
   {
+    RequestRedraw();
+
     cur_point_ = stamped_point;
 
     if (points_.empty() ||
@@ -204,6 +206,8 @@ namespace mapviz_plugins
 
   void PointDrawingPlugin::ClearPoints()
   {
+    RequestRedraw();
+
     points_.clear();
   }
 
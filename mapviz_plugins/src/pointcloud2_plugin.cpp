@@ -33,12 +33,16 @@
 // C++ standard libraries
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
+#include <limits>
+#include <set>
 #include <vector>
 #include <map>
 
 // Boost libraries
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 
 // QT libraries
 #include <QColorDialog>
@@ -50,6 +54,7 @@
 
 // ROS libraries
 #include <ros/master.h>
+#include <swri_transform_util/frames.h>
 #include <swri_transform_util/transform.h>
 #include <swri_yaml_util/yaml_util.h>
 
@@ -70,11 +75,13 @@ namespace mapviz_plugins
       min_value_(0.0),
       point_size_(3),
       buffer_size_(1),
-      new_topic_(true),
       has_message_(false),
       num_of_feats_(0),
       need_new_list_(true),
-      need_minmax_(false)
+      next_vbo_slot_(0),
+      shader_checked_(false),
+      use_shader_(false),
+      background_decode_(false)
   {
     ui_.setupUi(config_widget_);
 
@@ -94,6 +101,11 @@ namespace mapviz_plugins
     // Set color transformer choices
     ui_.color_transformer->addItem(QString("Flat Color"), QVariant(0));
 
+    settings_.generation = 0;
+    settings_.use_shader = false;
+    ResetAutoRange();
+    UpdateDecodeSettings();
+
     QObject::connect(ui_.selecttopic,
                      SIGNAL(clicked()),
                      this,
@@ -150,6 +162,10 @@ namespace mapviz_plugins
                      SIGNAL(stateChanged(int)),
                      this,
                      SLOT(UseAutomaxminChanged(int)));
+    QObject::connect(ui_.background_decode,
+                     SIGNAL(stateChanged(int)),
+                     this,
+                     SLOT(BackgroundDecodeChanged(int)));
     QObject::connect(ui_.max_color,
                      SIGNAL(colorEdited(const QColor &)),
                      this,
@@ -172,12 +188,18 @@ namespace mapviz_plugins
 
   PointCloud2Plugin::~PointCloud2Plugin()
   {
+    // Stop the decode thread before anything it uses is destroyed.
+    pc2_sub_.shutdown();
+    decode_spinner_.reset();
+    DeleteVertexBuffers();
   }
 
   void PointCloud2Plugin::ClearHistory()
   {
     ROS_DEBUG("PointCloud2Plugin::ClearHistory()");
+    QMutexLocker locker(&scan_mutex_);
     scans_.clear();
+    next_vbo_slot_ = 0;
   }
 
   void PointCloud2Plugin::DrawIcon()
@@ -216,12 +238,14 @@ namespace mapviz_plugins
 
   void PointCloud2Plugin::ResetTransformedPointClouds()
   {
+    UpdateDecodeSettings();
+
     QMutexLocker locker(&scan_mutex_);
     for (Scan& scan: scans_)
     {
+      // The points are in the source frame and colors only depend on the
+      // decoded fields, so both stay valid and on the GPU.
       scan.transformed = false;
-      scan.gl_color.clear();
-      scan.gl_point.clear();
     }
   }
 
@@ -229,83 +253,86 @@ namespace mapviz_plugins
   {
       QMutexLocker locker(&scan_mutex_);
       scans_.clear();
+      next_vbo_slot_ = 0;
   }
 
   void PointCloud2Plugin::SetSubscription(bool subscribe)
   {
     pc2_sub_.shutdown();
-
-    if (subscribe && !topic_.empty())
+    if (decode_spinner_)
     {
-      pc2_sub_ = node_.subscribe(topic_, 10, &PointCloud2Plugin::PointCloud2Callback, this);
-      new_topic_ = true;
-      need_new_list_ = true;
-      max_.clear();
-      min_.clear();
+      decode_spinner_->stop();
+      decode_spinner_.reset();
     }
-  }
+    decode_queue_.clear();
 
-  QColor PointCloud2Plugin::CalculateColor(const StampedPoint& point)
-  {
-    float val;
-    unsigned int color_transformer = static_cast<unsigned int>(ui_.color_transformer->currentIndex());
-    unsigned int transformer_index = color_transformer -1;
-    if (num_of_feats_ > 0 && color_transformer > 0)
-    {
-      val = point.features[transformer_index];
-      if (need_minmax_)
-      {
-        if (val > max_[transformer_index])
-        {
-          max_[transformer_index] = val;
-        }
-
-        if (val < min_[transformer_index])
-        {
-          min_[transformer_index] = val;
-        }
-      }
-    }
-    else  // No intensity or  (color_transformer == COLOR_FLAT)
+    // Discard scans decoded for the previous subscription.
+    Scan* scan;
+    while (handoff_.Consume(scan))
     {
-      return ui_.min_color->color();
+      handoff_.Recycle(scan);
     }
 
-    if (ui_.unpack_rgb->isChecked())
+    if (subscribe && !topic_.empty())
     {
-        uint8_t* pixelColor = reinterpret_cast<uint8_t*>(&val);
-        return QColor(pixelColor[2], pixelColor[1], pixelColor[0], 255);
-    }
+      need_new_list_ = true;
+      ResetAutoRange();
 
-    if (max_value_ > min_value_)
-    {
-      val = (val - min_value_) / (max_value_ - min_value_);
+      if (background_decode_)
+      {
+        ros::SubscribeOptions options = ros::SubscribeOptions::create<sensor_msgs::PointCloud2>(
+            topic_,
+            10,
+            boost::bind(&PointCloud2Plugin::BackgroundPointCloud2Callback, this, _1),
+            ros::VoidPtr(),
+            &decode_queue_);
+        pc2_sub_ = node_.subscribe(options);
+
+        decode_spinner_.reset(new ros::AsyncSpinner(1, &decode_queue_));
+        decode_spinner_->start();
+      }
+      else
+      {
+        pc2_sub_ = node_.subscribe(topic_, 10, &PointCloud2Plugin::PointCloud2Callback, this);
+      }
     }
-    val = std::max(0.0f, std::min(val, 1.0f));
+  }
 
-    if (ui_.use_automaxmin->isChecked())
-    {
-      max_value_ = max_[transformer_index];
-      min_value_ = min_[transformer_index];
-    }
+  void PointCloud2Plugin::BackgroundDecodeChanged(int check_state)
+  {
+    background_decode_ = check_state == Qt::Checked;
+    SetSubscription(this->Visible());
+  }
 
-    if (ui_.use_rainbow->isChecked())
-    {  // Hue Interpolation
+  void PointCloud2Plugin::UpdateDecodeSettings()
+  {
+    QMutexLocker locker(&settings_mutex_);
+    settings_.target_frame = target_frame_;
+    settings_.active_feature = active_feature_;
+    settings_.min_color = ui_.min_color->color();
+    settings_.max_color = ui_.max_color->color();
+    settings_.use_rainbow = ui_.use_rainbow->isChecked();
+    settings_.unpack_rgb = ui_.unpack_rgb->isChecked();
+    settings_.use_automaxmin = ui_.use_automaxmin->isChecked();
+    settings_.min_value = min_value_;
+    settings_.max_value = max_value_;
+    settings_.alpha = alpha_;
+    settings_.color_lut.Build(settings_.use_rainbow, settings_.min_color, settings_.max_color, alpha_);
+    settings_.use_shader = use_shader_;
+    settings_.generation++;
+  }
 
-      int hue = (int)(val * 255.0);
-      return QColor::fromHsl(hue, 255, 127, 255);
-    }
-    else
-    {
-      const QColor min_color = ui_.min_color->color();
-      const QColor max_color = ui_.max_color->color();
-      // RGB Interpolation
-      int red, green, blue;
-      red = (int)(val * max_color.red() + ((1.0 - val) * min_color.red()));
-      green = (int)(val * max_color.green() + ((1.0 - val) * min_color.green()));
-      blue = (int)(val * max_color.blue() + ((1.0 - val) * min_color.blue()));
-      return QColor(red, green, blue, 255);
-    }
+  PointCloud2Plugin::DecodeSettings PointCloud2Plugin::CopySettings()
+  {
+    QMutexLocker locker(&settings_mutex_);
+    return settings_;
+  }
+
+  void PointCloud2Plugin::ResetAutoRange()
+  {
+    QMutexLocker locker(&settings_mutex_);
+    settings_.auto_min = std::numeric_limits<float>::max();
+    settings_.auto_max = -std::numeric_limits<float>::max();
   }
 
   inline int32_t findChannelIndex(const sensor_msgs::PointCloud2ConstPtr& cloud, const std::string& channel)
@@ -321,25 +348,80 @@ namespace mapviz_plugins
     return -1;
   }
 
-  void PointCloud2Plugin::UpdateColors()
+  /**
+   * Returns true if points are colored by the shader from their feature
+   * values.  Packed RGB can't be unpacked by the shader, so it is always
+   * done on the CPU.
+   */
+  bool PointCloud2Plugin::ShaderColors(const DecodeSettings& settings)
+  {
+    return settings.use_shader && !settings.unpack_rgb;
+  }
+
+  void PointCloud2Plugin::ColorScan(Scan& scan, const DecodeSettings& settings) const
+  {
+    if (ShaderColors(settings))
+    {
+      scan.gl_color.clear();
+      scan.settings_generation = settings.generation;
+      return;
+    }
+
+    scan.gl_color.resize(scan.gl_point.size() / 3);
+    if (scan.feature.empty())  // No feature or (color_transformer == COLOR_FLAT)
+    {
+      std::fill(scan.gl_color.begin(), scan.gl_color.end(), settings.color_lut.Flat());
+    }
+    else if (settings.unpack_rgb)
+    {
+      const int alpha = static_cast<int>(settings.alpha * 255.0);
+      for (size_t i = 0; i < scan.feature.size(); i++)
+      {
+        uint8_t pixelColor[4];
+        std::memcpy(pixelColor, &scan.feature[i], sizeof(pixelColor));
+        scan.gl_color[i] = ColorLut::Pack(pixelColor[2], pixelColor[1], pixelColor[0], alpha);
+      }
+    }
+    else
+    {
+      double min_value = settings.min_value;
+      double max_value = settings.max_value;
+      if (settings.use_automaxmin)
+      {
+        min_value = settings.auto_min;
+        max_value = settings.auto_max;
+      }
+      settings.color_lut.Map(scan.feature.data(), scan.feature.size(), min_value, max_value, scan.gl_color.data());
+    }
+    scan.color_dirty = true;
+    scan.settings_generation = settings.generation;
+  }
+
+  void PointCloud2Plugin::RecolorScans()
   {
+    const DecodeSettings settings = CopySettings();
     {
       QMutexLocker locker(&scan_mutex_);
       for (Scan& scan: scans_)
       {
-        scan.gl_color.clear();
-        scan.gl_color.reserve(scan.points.size()*4);
-        for (const StampedPoint& point: scan.points)
+        if (scan.feature_name != settings.active_feature)
         {
-          const QColor color = CalculateColor(point);
-          scan.gl_color.push_back( color.red());
-          scan.gl_color.push_back( color.green());
-          scan.gl_color.push_back( color.blue());
-          scan.gl_color.push_back( static_cast<uint8_t>(alpha_ * 255.0 ) );
+          // Only the previously active field was decoded for this scan, so
+          // it is drawn with the flat color until it is replaced.
+          scan.feature.clear();
+          scan.feature_name.clear();
+          scan.value_dirty = true;
         }
+        ColorScan(scan, settings);
       }
     }
-    canvas_->update();
+    RequestRedraw();
+  }
+
+  void PointCloud2Plugin::UpdateColors()
+  {
+    UpdateDecodeSettings();
+    RecolorScans();
   }
 
   void PointCloud2Plugin::SelectTopic()
@@ -364,6 +446,7 @@ namespace mapviz_plugins
       {
         QMutexLocker locker(&scan_mutex_);
         scans_.clear();
+        next_vbo_slot_ = 0;
       }
       has_message_ = false;
       PrintWarning("No messages received.");
@@ -396,19 +479,30 @@ namespace mapviz_plugins
       {
         scans_.pop_front();
       }
+
+      // Pack the surviving scans into the front of the ring so that the
+      // ring can be resized to the new buffer size on the next Draw().
+      for (size_t i = 0; i < scans_.size(); i++)
+      {
+        scans_[i].vbo_slot = i;
+        scans_[i].point_dirty = true;
+        scans_[i].value_dirty = true;
+        scans_[i].color_dirty = true;
+      }
+      next_vbo_slot_ = scans_.size() % buffer_size_;
     }
 
-    canvas_->update();
+    RequestRedraw();
   }
 
   void PointCloud2Plugin::PointSizeChanged(int value)
   {
     point_size_ = (size_t)value;
 
-    canvas_->update();
+    RequestRedraw();
   }
 
-  void PointCloud2Plugin::PointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& msg)
+  void PointCloud2Plugin::UpdateFieldList(const std::vector<sensor_msgs::PointField>& fields)
   {
     if (!has_message_)
     {
@@ -416,106 +510,220 @@ namespace mapviz_plugins
       has_message_ = true;
     }
 
-    // Note that unlike some plugins, this one does not store nor rely on the
-    // source_frame_ member variable.  This one can potentially store many
-    // messages with different source frames, so we need to store and transform
-    // them individually.
+    // Fields are listed by name.
+    std::set<std::string> new_features;
+    for (size_t i = 0; i < fields.size(); ++i)
+    {
+      new_features.insert(fields[i].name);
+    }
+    num_of_feats_ = new_features.size();
 
-    Scan scan;
+    int label = 1;
+    if (need_new_list_)
     {
-        // recycle already allocated memory, reusing an old scan
-      QMutexLocker locker(&scan_mutex_);
-      if (buffer_size_ > 0 )
+      int new_feature_index = ui_.color_transformer->currentIndex();
+      std::set<std::string>::const_iterator it;
+      for (it = new_features.begin(); it != new_features.end(); ++it)
       {
-          if( scans_.size() >= buffer_size_)
-          {
-              scan = std::move( scans_.front() );
-          }
-          else{
-             glGenBuffers(1, &scan.color_vbo);
-             glGenBuffers(1, &scan.point_vbo);
-          }
-          while (scans_.size() >= buffer_size_)
-          {
-            scans_.pop_front();
-          }
+        ui_.color_transformer->removeItem(static_cast<int>(num_of_feats_));
+        num_of_feats_--;
       }
-    }
 
-    scan.stamp = msg->header.stamp;
-    scan.color = QColor::fromRgbF(1.0f, 0.0f, 0.0f, 1.0f);
-    scan.source_frame = msg->header.frame_id;
-    scan.transformed = true;
+      for (it = new_features.begin(); it != new_features.end(); ++it)
+      {
+        std::string const field = *it;
+        if (field == saved_color_transformer_)
+        {
+          // The very first time we see a new set of features, that means the
+          // plugin was just created; if we have a saved value, set the current
+          // index to that and clear the saved value.
+          new_feature_index = label;
+          saved_color_transformer_ = "";
+        }
 
-    swri_transform_util::Transform transform;
-    if (!GetTransform(scan.source_frame, msg->header.stamp, transform))
+        ui_.color_transformer->addItem(QString::fromStdString(field), QVariant(label));
+        num_of_feats_++;
+        label++;
+
+      }
+      ui_.color_transformer->setCurrentIndex(new_feature_index);
+      need_new_list_ = false;
+    }
+  }
+
+  void PointCloud2Plugin::PointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& msg)
+  {
+    // Update the field list first so that a saved color transformer applies
+    // to the very first scan.
+    UpdateFieldList(msg->fields);
+
+    DecodeSettings settings = CopySettings();
+    std::string error;
+    const bool decoded = DecodeScan(msg, spare_scan_, settings, error);
+    if (!error.empty())
     {
-      scan.transformed = false;
-      PrintError("No transform between " + scan.source_frame + " and " + target_frame_);
+      PrintError(error);
+    }
+    if (!decoded)
+    {
+      return;
     }
 
-    int32_t xi = findChannelIndex(msg, "x");
-    int32_t yi = findChannelIndex(msg, "y");
-    int32_t zi = findChannelIndex(msg, "z");
+    {
+      QMutexLocker locker(&scan_mutex_);
+      StoreScan(spare_scan_);
+    }
+    RequestRedraw();
+  }
 
-    if (xi == -1 || yi == -1 || zi == -1)
+  void PointCloud2Plugin::BackgroundPointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr& msg)
+  {
+    // This runs on decode_spinner_'s thread, so it must not touch the
+    // widgets; everything it needs from the GUI comes from settings_.
+    DecodeSettings settings = CopySettings();
+    Scan* scan = handoff_.Acquire();
+    std::string error;
+    const bool decoded = DecodeScan(msg, *scan, settings, error);
+    if (!error.empty())
     {
+      ROS_ERROR_THROTTLE(1.0, "%s", error.c_str());
+    }
+    if (!decoded)
+    {
+      handoff_.Release(scan);
       return;
     }
 
-    if (new_topic_)
+    if (handoff_.Publish(scan))
+    {
+      QMetaObject::invokeMethod(this, "ConsumeDecodedScans", Qt::QueuedConnection);
+    }
+  }
+
+  void PointCloud2Plugin::ConsumeDecodedScans()
+  {
+    bool consumed = false;
+    Scan* scan;
+    while (handoff_.Consume(scan))
+    {
+      ProcessScan(*scan);
+      handoff_.Recycle(scan);
+      consumed = true;
+    }
+
+    if (consumed)
+    {
+      RequestRedraw();
+    }
+  }
+
+  void PointCloud2Plugin::ProcessScan(Scan& scan)
+  {
+    UpdateFieldList(scan.fields);
+
+    const DecodeSettings settings = CopySettings();
+    if (scan.settings_generation != settings.generation)
     {
-      for (size_t i = 0; i < msg->fields.size(); ++i)
+      // The settings changed while the scan was being decoded.
+      if (scan.target_frame != settings.target_frame)
+      {
+        scan.transformed = false;
+      }
+      if (scan.feature_name != settings.active_feature)
       {
-        FieldInfo input;
-        std::string name = msg->fields[i].name;
+        scan.feature.clear();
+        scan.feature_name.clear();
+        scan.value_dirty = true;
+      }
+      ColorScan(scan, settings);
+    }
+
+    QMutexLocker locker(&scan_mutex_);
+    StoreScan(scan);
+  }
 
-        uint32_t offset_value = msg->fields[i].offset;
-        uint8_t datatype_value = msg->fields[i].datatype;
-        input.offset = offset_value;
-        input.datatype = datatype_value;
-        scan.new_features.insert(std::pair<std::string, FieldInfo>(name, input));
+  void PointCloud2Plugin::StoreScan(Scan& scan)
+  {
+    // recycle already allocated memory, handing the evicted scan back
+    Scan evicted;
+    if (buffer_size_ > 0)
+    {
+      if (scans_.size() >= buffer_size_)
+      {
+        evicted = std::move(scans_.front());
+      }
+      while (scans_.size() >= buffer_size_)
+      {
+        scans_.pop_front();
       }
+      // Scans are evicted in FIFO order, so the next slot in the ring is
+      // either unused or belonged to the scan that was just evicted.
+      scan.vbo_slot = next_vbo_slot_;
+      next_vbo_slot_ = (next_vbo_slot_ + 1) % buffer_size_;
+    }
+    else
+    {
+      scan.vbo_slot = scans_.size();
+    }
+    scan.point_dirty = true;
+    scan.value_dirty = true;
+    scan.color_dirty = true;
 
-      new_topic_ = false;
-      num_of_feats_ = scan.new_features.size();
+    scans_.push_back( std::move(scan) );
+    scan = std::move(evicted);
+  }
 
-      max_.resize(num_of_feats_);
-      min_.resize(num_of_feats_);
+  bool PointCloud2Plugin::DecodeScan(const sensor_msgs::PointCloud2ConstPtr& msg,
+                                     Scan& scan,
+                                     DecodeSettings& settings,
+                                     std::string& error)
+  {
+    // Note that unlike some plugins, this one does not store nor rely on the
+    // source_frame_ member variable.  This one can potentially store many
+    // messages with different source frames, so we need to store and transform
+    // them individually.
 
-      int label = 1;
-      if (need_new_list_)
-      {
-        int new_feature_index = ui_.color_transformer->currentIndex();
-        std::map<std::string, FieldInfo>::const_iterator it;
-        for (it = scan.new_features.begin(); it != scan.new_features.end(); ++it)
-        {
-          ui_.color_transformer->removeItem(static_cast<int>(num_of_feats_));
-          num_of_feats_--;
-        }
+    int32_t xi = findChannelIndex(msg, "x");
+    int32_t yi = findChannelIndex(msg, "y");
+    int32_t zi = findChannelIndex(msg, "z");
 
-        for (it = scan.new_features.begin(); it != scan.new_features.end(); ++it)
-        {
-          std::string const field = it->first;
-          if (field == saved_color_transformer_)
-          {
-            // The very first time we see a new set of features, that means the
-            // plugin was just created; if we have a saved value, set the current
-            // index to that and clear the saved value.
-            new_feature_index = label;
-            saved_color_transformer_ = "";
-          }
+    if (xi == -1 || yi == -1 || zi == -1)
+    {
+      return false;
+    }
 
-          ui_.color_transformer->addItem(QString::fromStdString(field), QVariant(label));
-          num_of_feats_++;
-          label++;
+    if (msg->fields[xi].datatype != sensor_msgs::PointField::FLOAT32 ||
+        msg->fields[yi].datatype != sensor_msgs::PointField::FLOAT32 ||
+        msg->fields[zi].datatype != sensor_msgs::PointField::FLOAT32)
+    {
+      error = "Point coordinates must be float32";
+      return false;
+    }
 
-        }
-        ui_.color_transformer->setCurrentIndex(new_feature_index);
-        need_new_list_ = false;
-      }
+    scan.stamp = msg->header.stamp;
+    scan.color = QColor::fromRgbF(1.0f, 0.0f, 0.0f, 1.0f);
+    scan.source_frame = msg->header.frame_id;
+    scan.target_frame = settings.target_frame;
+    scan.fields = msg->fields;
+    scan.transformed = true;
+
+    swri_transform_util::Transform transform;
+    if (!GetTransform(settings.target_frame, scan.source_frame, msg->header.stamp, transform))
+    {
+      scan.transformed = false;
+      error = "No transform between " + scan.source_frame + " and " + settings.target_frame;
     }
 
+    scan.rigid = true;
+    scan.feature.clear();
+    scan.feature_name.clear();
+    scan.gl_point.clear();
+    scan.gl_transformed.clear();
+    scan.gl_color.clear();
+    scan.local_bounds.Clear();
+    scan.min_z = 0.0f;
+    scan.max_z = 0.0f;
+
     if (!msg->data.empty())
     {
       const uint8_t* ptr = &msg->data.front();
@@ -524,80 +732,176 @@ namespace mapviz_plugins
       const uint32_t yoff = msg->fields[yi].offset;
       const uint32_t zoff = msg->fields[zi].offset;
       const size_t num_points = msg->data.size() / point_step;
-      const size_t num_features = scan.new_features.size();
-      scan.points.resize(num_points);
 
-      std::vector<FieldInfo> field_infos;
-      field_infos.reserve(num_features);
-      for (auto it = scan.new_features.begin(); it != scan.new_features.end(); ++it)
+      // Only the field used by the active color transformer is decoded; the
+      // arrays below are reused from the recycled scan, so steady-state
+      // decoding does not allocate.
+      FieldInfo feature_info;
+      int32_t fi = settings.active_feature.empty() ? -1 : findChannelIndex(msg, settings.active_feature);
+      if (fi != -1)
       {
-        field_infos.push_back(it->second);
+        feature_info.offset = msg->fields[fi].offset;
+        feature_info.datatype = msg->fields[fi].datatype;
+        if (feature_info.datatype >= sensor_msgs::PointField::INT8 &&
+            feature_info.datatype <= sensor_msgs::PointField::FLOAT64)
+        {
+          scan.feature_name = settings.active_feature;
+          scan.feature.resize(num_points);
+        }
+        else
+        {
+          ROS_WARN("Unknown data type in point: %d", feature_info.datatype);
+        }
       }
 
-      scan.gl_point.clear();
-      scan.gl_point.reserve(num_points*2);
-      scan.gl_color.clear();
-      scan.gl_color.reserve(num_points*4);
+      scan.gl_point.resize(num_points * 3);
 
-      for (size_t i = 0; i < num_points; i++, ptr += point_step)
+      // Decode in a single pass of its own so that the message is streamed
+      // through the cache exactly once.  The field layout is fixed for the
+      // whole message, so the datatype switch in PointFeature takes the same
+      // branch for every point.
+      const bool has_feature = !scan.feature.empty();
+      float* point = scan.gl_point.data();
+      for (size_t i = 0; i < num_points; i++, ptr += point_step, point += 3)
       {
-        float x = *reinterpret_cast<const float*>(ptr + xoff);
-        float y = *reinterpret_cast<const float*>(ptr + yoff);
-        float z = *reinterpret_cast<const float*>(ptr + zoff);
+        std::memcpy(&point[0], ptr + xoff, sizeof(float));
+        std::memcpy(&point[1], ptr + yoff, sizeof(float));
+        std::memcpy(&point[2], ptr + zoff, sizeof(float));
+        if (has_feature)
+        {
+          scan.feature[i] = PointFeature(ptr, feature_info);
+        }
+      }
 
-        StampedPoint& point = scan.points[i];
-        point.point = tf::Point(x, y, z);
+      // The extent is found in a second pass over the packed points, which
+      // are still in the cache, rather than slowing down the decode loop.
+      float min_x = std::numeric_limits<float>::max();
+      float min_y = std::numeric_limits<float>::max();
+      float min_z = std::numeric_limits<float>::max();
+      float max_x = -std::numeric_limits<float>::max();
+      float max_y = -std::numeric_limits<float>::max();
+      float max_z = -std::numeric_limits<float>::max();
+      point = scan.gl_point.data();
+      for (size_t i = 0; i < num_points; i++, point += 3)
+      {
+        // NaN points fail every comparison and are left out
+        min_x = std::min(min_x, point[0]);
+        max_x = std::max(max_x, point[0]);
+        min_y = std::min(min_y, point[1]);
+        max_y = std::max(max_y, point[1]);
+        min_z = std::min(min_z, point[2]);
+        max_z = std::max(max_z, point[2]);
+      }
+      if (min_x <= max_x && min_y <= max_y && min_z <= max_z)
+      {
+        scan.local_bounds = mapviz::BoundingBox(min_x, min_y, max_x, max_y);
+        scan.min_z = min_z;
+        scan.max_z = max_z;
+      }
 
-        point.features.resize(num_features);
+      if (scan.transformed)
+      {
+        TransformScan(scan, transform);
+      }
+    }
 
-        for (int count=0; count < field_infos.size(); count++)
-        {
-          point.features[count] = PointFeature(ptr, field_infos[count]);
-        }
-        if (scan.transformed)
-        {
-          const tf::Point transformed_point = transform * point.point;
-          scan.gl_point.push_back( transformed_point.getX() );
-          scan.gl_point.push_back( transformed_point.getY() );
-        }
-        const QColor color = CalculateColor(point);
-        scan.gl_color.push_back( color.red());
-        scan.gl_color.push_back( color.green());
-        scan.gl_color.push_back( color.blue());
-        scan.gl_color.push_back( static_cast<uint8_t>(alpha_ * 255.0 ) );
+    if (!scan.feature.empty() && settings.use_automaxmin)
+    {
+      const std::pair<std::vector<float>::const_iterator, std::vector<float>::const_iterator> range =
+          std::minmax_element(scan.feature.begin(), scan.feature.end());
+
+      QMutexLocker locker(&settings_mutex_);
+      if (settings_.active_feature == scan.feature_name)
+      {
+        settings_.auto_min = std::min(settings_.auto_min, *range.first);
+        settings_.auto_max = std::max(settings_.auto_max, *range.second);
       }
+      settings.auto_min = settings_.auto_min;
+      settings.auto_max = settings_.auto_max;
     }
 
+    ColorScan(scan, settings);
+
+    return true;
+  }
+
+  /**
+   * Transforms a scan to its target frame.  The points stay in the source
+   * frame and are drawn with the transform as a matrix, so this doesn't
+   * touch them unless the transform isn't rigid.
+   */
+  void PointCloud2Plugin::TransformScan(Scan& scan, const swri_transform_util::Transform& transform)
+  {
+    // Transforms to or from WGS84 can't be expressed as a matrix.
+    const bool rigid =
+        !swri_transform_util::FrameIdsEqual(scan.source_frame, swri_transform_util::_wgs84_frame) &&
+        !swri_transform_util::FrameIdsEqual(scan.target_frame, swri_transform_util::_wgs84_frame);
+
+    scan.matrix = tf::Transform(transform.GetOrientation(), transform.GetOrigin());
+    if (rigid)
     {
-      QMutexLocker locker(&scan_mutex_);
-      scans_.push_back( std::move(scan) );
+      scan.gl_transformed.clear();
+      scan.bounds = scan.local_bounds.Transformed(scan.matrix, scan.min_z, scan.max_z);
+      if (!scan.rigid)
+      {
+        // The GPU has the target frame points
+        scan.point_dirty = true;
+      }
+    }
+    else
+    {
+      scan.gl_transformed.resize(scan.gl_point.size());
+      scan.bounds.Clear();
+      for (size_t i = 0; i < scan.gl_point.size(); i += 3)
+      {
+        const tf::Point transformed_point =
+            transform * tf::Point(scan.gl_point[i], scan.gl_point[i + 1], scan.gl_point[i + 2]);
+        scan.bounds.Extend(transformed_point);
+        scan.gl_transformed[i] = transformed_point.getX();
+        scan.gl_transformed[i + 1] = transformed_point.getY();
+        scan.gl_transformed[i + 2] = 0.0f;
+      }
+      scan.point_dirty = true;
     }
-    new_topic_ = true;
-    canvas_->update();
+    scan.rigid = rigid;
+    scan.transformed = true;
+  }
+
+  /**
+   * Reads a field of type T from a point and converts it to a float.  memcpy
+   * keeps unaligned fields well defined and compiles to a plain load.
+   */
+  template <typename T>
+  inline float ReadField(const uint8_t* data, uint32_t offset)
+  {
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return static_cast<float>(value);
   }
 
   float PointCloud2Plugin::PointFeature(const uint8_t* data, const FieldInfo& feature_info)
   {
     switch (feature_info.datatype)
     {
-      case 1:
-        return *reinterpret_cast<const int8_t*>(data + feature_info.offset);
-      case 2:
-        return *(data + feature_info.offset);
-      case 3:
-        return *reinterpret_cast<const int16_t*>(data + feature_info.offset);
-      case 4:
-        return *reinterpret_cast<const uint16_t*>(data + feature_info.offset);
-      case 5:
-        return *reinterpret_cast<const int32_t*>(data + feature_info.offset);
-      case 6:
-        return *reinterpret_cast<const uint32_t*>(data + feature_info.offset);
-      case 7:
-        return *reinterpret_cast<const float*>(data + feature_info.offset);
-      case 8:
-        return *reinterpret_cast<const double*>(data + feature_info.offset);
+      case sensor_msgs::PointField::INT8:
+        return ReadField<int8_t>(data, feature_info.offset);
+      case sensor_msgs::PointField::UINT8:
+        return ReadField<uint8_t>(data, feature_info.offset);
+      case sensor_msgs::PointField::INT16:
+        return ReadField<int16_t>(data, feature_info.offset);
+      case sensor_msgs::PointField::UINT16:
+        return ReadField<uint16_t>(data, feature_info.offset);
+      case sensor_msgs::PointField::INT32:
+        return ReadField<int32_t>(data, feature_info.offset);
+      case sensor_msgs::PointField::UINT32:
+        return ReadField<uint32_t>(data, feature_info.offset);
+      case sensor_msgs::PointField::FLOAT32:
+        return ReadField<float>(data, feature_info.offset);
+      case sensor_msgs::PointField::FLOAT64:
+        return ReadField<double>(data, feature_info.offset);
       default:
-        ROS_WARN("Unknown data type in point: %d", feature_info.datatype);
+        // Unknown datatypes are rejected once per message in
+        // DecodeScan before any point is decoded.
         return 0.0;
     }
   }
@@ -633,34 +937,216 @@ namespace mapviz_plugins
     return true;
   }
 
+  void PointCloud2Plugin::ResizeVertexBufferRing()
+  {
+    const size_t num_slots = std::max(buffer_size_, scans_.size());
+
+    while (vbo_ring_.size() > num_slots)
+    {
+      glDeleteBuffers(1, &vbo_ring_.back().point_vbo);
+      glDeleteBuffers(1, &vbo_ring_.back().value_vbo);
+      glDeleteBuffers(1, &vbo_ring_.back().color_vbo);
+      vbo_ring_.pop_back();
+    }
+
+    while (vbo_ring_.size() < num_slots)
+    {
+      VertexBufferSlot slot;
+      glGenBuffers(1, &slot.point_vbo);
+      glGenBuffers(1, &slot.value_vbo);
+      glGenBuffers(1, &slot.color_vbo);
+      slot.point_capacity = 0;
+      slot.value_capacity = 0;
+      slot.color_capacity = 0;
+      vbo_ring_.push_back(slot);
+    }
+  }
+
+  void PointCloud2Plugin::DeleteVertexBuffers()
+  {
+    for (VertexBufferSlot& slot: vbo_ring_)
+    {
+      glDeleteBuffers(1, &slot.point_vbo);
+      glDeleteBuffers(1, &slot.value_vbo);
+      glDeleteBuffers(1, &slot.color_vbo);
+    }
+    vbo_ring_.clear();
+  }
+
+  void PointCloud2Plugin::UploadScan(Scan& scan, bool shader_colors)
+  {
+    VertexBufferSlot& slot = vbo_ring_[scan.vbo_slot];
+
+    if (scan.point_dirty)
+    {
+      const std::vector<float>& points = scan.rigid ? scan.gl_point : scan.gl_transformed;
+      const size_t bytes = points.size() * sizeof(float);
+      glBindBuffer(GL_ARRAY_BUFFER, slot.point_vbo);
+      if (bytes > slot.point_capacity)
+      {
+        glBufferData(GL_ARRAY_BUFFER, bytes, points.data(), GL_DYNAMIC_DRAW);
+        slot.point_capacity = bytes;
+      }
+      else
+      {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, points.data());
+      }
+      scan.point_dirty = false;
+    }
+
+    // Values and colors are only uploaded while they are what is drawn
+    if (scan.value_dirty && shader_colors)
+    {
+      const size_t bytes = scan.feature.size() * sizeof(float);
+      glBindBuffer(GL_ARRAY_BUFFER, slot.value_vbo);
+      if (bytes > slot.value_capacity)
+      {
+        glBufferData(GL_ARRAY_BUFFER, bytes, scan.feature.data(), GL_DYNAMIC_DRAW);
+        slot.value_capacity = bytes;
+      }
+      else
+      {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, scan.feature.data());
+      }
+      scan.value_dirty = false;
+    }
+
+    if (scan.color_dirty && !shader_colors)
+    {
+      const size_t bytes = scan.gl_color.size() * sizeof(uint32_t);
+      glBindBuffer(GL_ARRAY_BUFFER, slot.color_vbo);
+      if (bytes > slot.color_capacity)
+      {
+        glBufferData(GL_ARRAY_BUFFER, bytes, scan.gl_color.data(), GL_DYNAMIC_DRAW);
+        slot.color_capacity = bytes;
+      }
+      else
+      {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, scan.gl_color.data());
+      }
+      scan.color_dirty = false;
+    }
+  }
+
   void PointCloud2Plugin::Draw(double x, double y, double scale)
   {
+    if (!shader_checked_)
+    {
+      use_shader_ = colormap_shader_.Initialize(canvas_->context());
+      shader_checked_ = true;
+      // Drop the colors computed on the CPU until now
+      UpdateColors();
+    }
+
+    const DecodeSettings settings = CopySettings();
+    const bool shader_colors = ShaderColors(settings);
+
     glPointSize(point_size_);
 
     glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_COLOR_ARRAY);
+    int value_location = -1;
+    if (shader_colors)
+    {
+      double min_value = settings.min_value;
+      double max_value = settings.max_value;
+      if (settings.use_automaxmin)
+      {
+        min_value = settings.auto_min;
+        max_value = settings.auto_max;
+      }
+      colormap_shader_.Bind(min_value,
+                            max_value,
+                            settings.use_rainbow,
+                            settings.min_color,
+                            settings.max_color,
+                            settings.alpha);
+      value_location = colormap_shader_.ValueLocation();
+    }
+    else
+    {
+      glEnableClientState(GL_COLOR_ARRAY);
+    }
 
     {
       QMutexLocker locker(&scan_mutex_);
 
+      ResizeVertexBufferRing();
+
       for (Scan& scan: scans_)
       {
-        if (scan.transformed && !scan.gl_color.empty())
+        size_t num_points = scan.gl_point.size() / 3;
+        if (!shader_colors)
+        {
+          num_points = std::min(num_points, scan.gl_color.size());
+        }
+        else if (!scan.feature.empty())
+        {
+          num_points = std::min(num_points, scan.feature.size());
+        }
+
+        // Scans that are entirely off screen aren't uploaded or drawn
+        mapviz::BoundingBox bounds = scan.bounds;
+        bounds.Pad(point_size_ * scale);
+        if (scan.transformed && num_points > 0 && draw_context_.IsVisible(bounds))
         {
-          glBindBuffer(GL_ARRAY_BUFFER, scan.point_vbo);  // coordinates
-          glBufferData(GL_ARRAY_BUFFER, scan.gl_point.size() * sizeof(float), scan.gl_point.data(), GL_STATIC_DRAW);
-          glVertexPointer( 2, GL_FLOAT, 0, 0);
+          // Only scans that are new, re-transformed or re-colored since the
+          // last frame are sent to the GPU; everything else is already there.
+          UploadScan(scan, shader_colors);
+
+          const VertexBufferSlot& slot = vbo_ring_[scan.vbo_slot];
+          glBindBuffer(GL_ARRAY_BUFFER, slot.point_vbo);  // coordinates
+          glVertexPointer( 3, GL_FLOAT, 0, 0);
 
-          glBindBuffer(GL_ARRAY_BUFFER, scan.color_vbo);  // color
-          glBufferData(GL_ARRAY_BUFFER, scan.gl_color.size() * sizeof(uint8_t), scan.gl_color.data(), GL_STATIC_DRAW);
-          glColorPointer( 4, GL_UNSIGNED_BYTE, 0, 0);
+          if (shader_colors)
+          {
+            // Scans without the active feature are drawn in the flat color
+            const bool flat = scan.feature.empty();
+            colormap_shader_.SetFlat(flat);
+            if (flat)
+            {
+              glDisableVertexAttribArray(value_location);
+              glVertexAttrib1f(value_location, 0.0f);
+            }
+            else
+            {
+              glEnableVertexAttribArray(value_location);
+              glBindBuffer(GL_ARRAY_BUFFER, slot.value_vbo);  // feature
+              glVertexAttribPointer(value_location, 1, GL_FLOAT, GL_FALSE, 0, 0);
+            }
+          }
+          else
+          {
+            glBindBuffer(GL_ARRAY_BUFFER, slot.color_vbo);  // color
+            glColorPointer( 4, GL_UNSIGNED_BYTE, 0, 0);
+          }
 
-          glDrawArrays(GL_POINTS, 0, scan.gl_point.size() / 2 );
+          if (scan.rigid)
+          {
+            double matrix[16];
+            mapviz::GetPlanarGLMatrix(scan.matrix, matrix);
+            glPushMatrix();
+            glMultMatrixd(matrix);
+            glDrawArrays(GL_POINTS, 0, num_points);
+            glPopMatrix();
+          }
+          else
+          {
+            glDrawArrays(GL_POINTS, 0, num_points);
+          }
         }
       }
     }
+
+    if (shader_colors)
+    {
+      glDisableVertexAttribArray(value_location);
+      colormap_shader_.Release();
+    }
+    else
+    {
+      glDisableClientState(GL_COLOR_ARRAY);
+    }
     glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_COLOR_ARRAY);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     PrintInfo("OK");
@@ -674,13 +1160,6 @@ namespace mapviz_plugins
 
   void PointCloud2Plugin::UseAutomaxminChanged(int check_state)
   {
-    need_minmax_ = check_state == Qt::Checked;
-    if( !need_minmax_ )
-    {
-      min_value_ = ui_.minValue->value();
-      max_value_ = ui_.maxValue->value();
-    }
-
     UpdateMinMaxWidgets();
     UpdateColors();
   }
@@ -699,16 +1178,8 @@ namespace mapviz_plugins
           swri_transform_util::Transform transform;
           if (GetTransform(scan.source_frame, scan.stamp, transform))
           {
-            scan.gl_point.clear();
-            scan.gl_point.reserve(scan.points.size()*2);
-
-            scan.transformed = true;
-            for (StampedPoint& point: scan.points)
-            {
-              const tf::Point transformed_point = transform * point.point;
-              scan.gl_point.push_back( transformed_point.getX() );
-              scan.gl_point.push_back( transformed_point.getY() );
-            }
+            scan.target_frame = target_frame_;
+            TransformScan(scan, transform);
           }
           else
           {
@@ -719,12 +1190,6 @@ namespace mapviz_plugins
       }
       use_latest_transforms_ = was_using_latest_transforms;
     }
-    // Z color is based on transformed color, so it is dependent on the
-    // transform
-    if (ui_.color_transformer->currentIndex() == COLOR_Z)
-    {
-      UpdateColors();
-    }
   }
 
   void PointCloud2Plugin::LoadConfig(const YAML::Node& node,
@@ -750,6 +1215,13 @@ namespace mapviz_plugins
       ui_.bufferSize->setValue(static_cast<int>(buffer_size_));
     }
 
+    if (node["background_decode"])
+    {
+      bool background_decode;
+      node["background_decode"] >> background_decode;
+      ui_.background_decode->setChecked(background_decode);
+    }
+
     if (node["color_transformer"])
     {
       node["color_transformer"] >> saved_color_transformer_;
@@ -819,6 +1291,15 @@ namespace mapviz_plugins
   void PointCloud2Plugin::ColorTransformerChanged(int index)
   {
     ROS_DEBUG("Color transformer changed to %d", index);
+    if (index > 0)
+    {
+      active_feature_ = ui_.color_transformer->itemText(index).toStdString();
+    }
+    else
+    {
+      active_feature_.clear();
+    }
+    ResetAutoRange();
     UpdateMinMaxWidgets();
     UpdateColors();
   }
@@ -860,6 +1341,7 @@ namespace mapviz_plugins
   void PointCloud2Plugin::AlphaEdited(double value)
   {
     alpha_ = std::max(0.0f, std::min((float)value, 1.0f));
+    UpdateColors();
   }
 
   void PointCloud2Plugin::SaveConfig(YAML::Emitter& emitter,
@@ -871,6 +1353,8 @@ namespace mapviz_plugins
       YAML::Value << ui_.pointSize->value();
     emitter << YAML::Key << "buffer_size" <<
       YAML::Value << ui_.bufferSize->value();
+    emitter << YAML::Key << "background_decode" <<
+      YAML::Value << ui_.background_decode->isChecked();
     emitter << YAML::Key << "alpha" <<
       YAML::Value << alpha_;
     emitter << YAML::Key << "color_transformer" <<
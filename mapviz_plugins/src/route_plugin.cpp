@@ -206,11 +206,15 @@ namespace mapviz_plugins
   void RoutePlugin::PositionCallback(
       const marti_nav_msgs::RoutePositionConstPtr& msg)
   {
+    RequestRedraw();
+
     src_route_position_ = msg;
   }
 
   void RoutePlugin::RouteCallback(const marti_nav_msgs::RouteConstPtr& msg)
   {
+    RequestRedraw();
+
     src_route_ = sru::Route(*msg);
   }
 
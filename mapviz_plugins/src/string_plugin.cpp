@@ -395,6 +395,8 @@ namespace mapviz_plugins
 
   void StringPlugin::stringCallback(const topic_tools::ShapeShifter::ConstPtr& msg)
   {
+    RequestRedraw();
+
     if (is_instance<std_msgs::String>(msg))
     {
       message_.setText(QString(msg->instantiate<std_msgs::String>()->data.c_str()));
@@ -100,6 +100,7 @@ namespace mapviz_plugins
   {
     ROS_DEBUG("TexturedMarkerPlugin::ClearHistory()");
     markers_.clear();
+    expiry_queue_.Clear();
   }
 
   // TODO could instead use the value() function on alphaSlide when needed, assuming value is always good
@@ -150,6 +151,7 @@ namespace mapviz_plugins
     {
       initialized_ = false;
       markers_.clear();
+      expiry_queue_.Clear();
       has_message_ = false;
       PrintWarning("No messages received.");
 
@@ -179,6 +181,8 @@ namespace mapviz_plugins
 
   void TexturedMarkerPlugin::ProcessMarker(const marti_visualization_msgs::TexturedMarker& marker)
   {
+    RequestRedraw();
+
     if (!has_message_)
     {
       initialized_ = true;
@@ -217,6 +221,7 @@ namespace mapviz_plugins
         // Temporarily add 5 seconds to fix some existing markers.
         markerData.expire_time = ros::Time::now() + lifetime + ros::Duration(5);
       }
+      expiry_queue_.Push(std::make_pair(marker.ns, marker.id), markerData.expire_time);
 
       tf::Transform offset(
         tf::Quaternion(
@@ -420,6 +425,38 @@ namespace mapviz_plugins
     }
   }
   
+  /**
+   * Removes every marker whose lifetime has run out, along with its texture.
+   */
+  void TexturedMarkerPlugin::RemoveExpiredMarkers(const ros::Time& now)
+  {
+    std::pair<std::string, int> id;
+    ros::Time expire_time;
+    while (expiry_queue_.PopExpired(now, id, expire_time))
+    {
+      // Markers that were deleted or added again since this entry was made
+      // are either gone or have a different expiration time.
+      std::map<std::string, std::map<int, MarkerData> >::iterator nsIter = markers_.find(id.first);
+      if (nsIter == markers_.end())
+      {
+        continue;
+      }
+
+      std::map<int, MarkerData>::iterator markerIter = nsIter->second.find(id.second);
+      if (markerIter == nsIter->second.end() || markerIter->second.expire_time != expire_time)
+      {
+        continue;
+      }
+
+      if (markerIter->second.texture_id_ > 0)
+      {
+        GLuint texture = static_cast<GLuint>(markerIter->second.texture_id_);
+        glDeleteTextures(1, &texture);
+      }
+      nsIter->second.erase(markerIter);
+    }
+  }
+
   void TexturedMarkerPlugin::ProcessMarkers(const marti_visualization_msgs::TexturedMarkerArrayConstPtr markers)
   {
     for (unsigned int i = 0; i < markers->markers.size(); i++)
@@ -471,6 +508,7 @@ namespace mapviz_plugins
   void TexturedMarkerPlugin::Draw(double x, double y, double scale)
   {
     ros::Time now = ros::Time::now();
+    RemoveExpiredMarkers(now);
 
     float alphaVal = alphaVal_; // Set all markers to same alpha value
 
@@ -73,6 +73,11 @@ namespace mapviz_plugins
 
     QWidget* GetConfigWidget(QWidget* parent);
 
+    bool SupportsLayerCaching()
+    {
+      return true;
+    }
+
   protected:
     void PrintError(const std::string& message);
     void PrintInfo(const std::string& message);
@@ -48,7 +48,11 @@ class MultiresView
 
     void SetView(double x, double y, double radius, double scale);
 
-    void Draw();
+    /**
+     * Returns false if some tiles were left out because they are still
+     * being loaded.
+     */
+    bool Draw();
 
     void Exit() { m_cache.Exit(); }
 
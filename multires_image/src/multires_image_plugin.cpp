@@ -127,6 +127,7 @@ namespace mapviz_plugins
     }
     else
     {
+      DataChanged();
       loaded_ = false;
       delete tile_set_;
       delete tile_view_;
@@ -181,11 +182,13 @@ namespace mapviz_plugins
   void MultiresImagePlugin::SetXOffset(double offset_x)
   {
       offset_x_ = offset_x;
+      DataChanged();
   }
 
   void MultiresImagePlugin::SetYOffset(double offset_y)
   {
       offset_y_ = offset_y;
+      DataChanged();
   }
 
   QWidget* MultiresImagePlugin::GetConfigWidget(QWidget* parent)
@@ -217,7 +220,11 @@ namespace mapviz_plugins
       GetCenterPoint(x, y);
       tile_view_->SetView(center_x_, center_y_, 1, scale);
 
-      tile_view_->Draw();
+      if (!tile_view_->Draw())
+      {
+        // Draw again once the missing tiles have loaded.
+        DataChanged();
+      }
 
       PrintInfo("OK");
     }
@@ -225,6 +232,8 @@ namespace mapviz_plugins
 
   void MultiresImagePlugin::Transform()
   {
+    bool was_transformed = transformed_;
+    swri_transform_util::Transform previous = transform_;
     transformed_ = false;
 
     if (!loaded_)
@@ -233,9 +242,20 @@ namespace mapviz_plugins
     if (!tf_manager_->GetTransform(target_frame_, source_frame_, transform_))
     {
       PrintError("Failed transform from " + source_frame_ + " to " + target_frame_);
+      if (was_transformed)
+      {
+        DataChanged();
+      }
       return;
     }
 
+    if (!was_transformed ||
+        transform_.GetOrigin() != previous.GetOrigin() ||
+        transform_.GetOrientation() != previous.GetOrientation())
+    {
+      DataChanged();
+    }
+
     if (!tf_manager_->GetTransform(source_frame_, target_frame_, inverse_transform_))
     {
       PrintError("Failed inverse transform from " + target_frame_ + " to " + source_frame_);
@@ -127,8 +127,9 @@ namespace mapviz_plugins
     m_cache.Precache(x, y);
   }
 
-  void MultiresView::Draw()
+  bool MultiresView::Draw()
   {
+    bool complete = true;
     glEnable(GL_TEXTURE_2D);
 
     glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
@@ -144,6 +145,12 @@ namespace mapviz_plugins
     else
     {
       m_cache.Load(tile);
+      // Tiles that failed to load never will, so they don't leave the
+      // view incomplete.
+      if (!tile->Failed())
+      {
+        complete = false;
+      }
     }
 
     if(m_tiles->LayerCount() >= 2)
@@ -161,6 +168,10 @@ namespace mapviz_plugins
           else
           {
             m_cache.Load(tile);
+            if (!tile->Failed())
+            {
+              complete = false;
+            }
           }
         }
       }
@@ -183,6 +194,10 @@ namespace mapviz_plugins
             else
             {
               m_cache.Load(tile);
+              if (!tile->Failed())
+              {
+                complete = false;
+              }
             }
           }
         }
@@ -190,5 +205,7 @@ namespace mapviz_plugins
     }
 
     glDisable(GL_TEXTURE_2D);
+
+    return complete;
   }
 }
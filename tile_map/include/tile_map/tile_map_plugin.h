@@ -76,6 +76,11 @@ namespace tile_map
 
     QWidget* GetConfigWidget(QWidget* parent);
 
+    bool SupportsLayerCaching()
+    {
+      return true;
+    }
+
   protected Q_SLOTS:
     void PrintError(const std::string& message);
     void PrintInfo(const std::string& message);
@@ -69,7 +69,10 @@ namespace tile_map
 
     void SetTileSource(const boost::shared_ptr<TileSource>& tile_source);
 
-    void SetTransform(const swri_transform_util::Transform& transform);
+    /**
+     * Returns false if the transform is unchanged.
+     */
+    bool SetTransform(const swri_transform_util::Transform& transform);
 
     void SetView(
       double latitude,
@@ -78,10 +81,14 @@ namespace tile_map
       int32_t width,
       int32_t height);
 
-    void Draw();
+    /**
+     * Returns false if some tiles were left out because they are still
+     * being loaded.
+     */
+    bool Draw();
 
   private:
-    void DrawTiles(std::vector<Tile> &tiles ,int priority);
+    bool DrawTiles(std::vector<Tile> &tiles ,int priority);
 
     boost::shared_ptr<TileSource> tile_source_;
 
@@ -241,6 +241,7 @@ namespace tile_map
   void TileMapPlugin::ResetTileCache()
   {
     tile_map_.ResetCache();
+    DataChanged();
   }
 
   void TileMapPlugin::PrintError(const std::string& message)
@@ -308,23 +309,35 @@ namespace tile_map
       tf::Vector3 center(x, y, 0);
       center = to_wgs84 * center;
 
+      // The viewport is larger than the canvas when drawing into a cached
+      // layer.
+      GLint viewport[4];
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      const int32_t width = viewport[2];
+      const int32_t height = viewport[3];
+
       if (center.y() != last_center_y_ ||
           center.x() != last_center_x_ ||
           scale != last_scale_ ||
-          canvas_->width() != last_width_ ||
-          canvas_->height() != last_height_)
+          width != last_width_ ||
+          height != last_height_)
       {
         // Draw() is called very frequently, and SetView is a fairly expensive operation, so we
         // can save some CPU time by only calling it when the relevant parameters have changed.
         last_center_y_ = center.y();
         last_center_x_ = center.x();
         last_scale_ = scale;
-        last_width_ = canvas_->width();
-        last_height_ = canvas_->height();
-        tile_map_.SetView(center.y(), center.x(), scale, canvas_->width(), canvas_->height());
+        last_width_ = width;
+        last_height_ = height;
+        tile_map_.SetView(center.y(), center.x(), scale, width, height);
         ROS_DEBUG("TileMapPlugin::Draw: Successfully set view");
       }
-      tile_map_.Draw();
+
+      if (!tile_map_.Draw())
+      {
+        // Draw again once the missing tiles have loaded.
+        DataChanged();
+      }
     }
   }
 
@@ -333,7 +346,10 @@ namespace tile_map
     swri_transform_util::Transform to_target;
     if (tf_manager_->GetTransform(target_frame_, source_frame_, to_target))
     {
-      tile_map_.SetTransform(to_target);
+      if (tile_map_.SetTransform(to_target))
+      {
+        DataChanged();
+      }
       PrintInfo("OK");
     }
     else
@@ -437,6 +453,7 @@ namespace tile_map
   {
     last_height_ = 0; // This will force us to recalculate our view
     tile_map_.SetTileSource(tile_source);
+    DataChanged();
     if (tile_source->GetType() == BingSource::BING_TYPE)
     {
       BingSource* bing_source = static_cast<BingSource*>(tile_source.get());
@@ -72,12 +72,12 @@ namespace tile_map
     level_ = -1;
   }
 
-  void TileMapView::SetTransform(const swri_transform_util::Transform& transform)
+  bool TileMapView::SetTransform(const swri_transform_util::Transform& transform)
   {
     if (transform.GetOrigin() == transform_.GetOrigin() &&
         transform.GetOrientation() == transform_.GetOrientation())
     {
-      return;
+      return false;
     }
 
     transform_ = transform;
@@ -97,6 +97,8 @@ namespace tile_map
         precache_[i].points_t[j] = transform_ * precache_[i].points[j];
       }
     }
+
+    return true;
   }
 
   void TileMapView::SetView(
@@ -208,8 +210,9 @@ namespace tile_map
     }
   }
 
-  void TileMapView::DrawTiles(std::vector<Tile>& tiles, int priority)
+  bool TileMapView::DrawTiles(std::vector<Tile>& tiles, int priority)
   {
+    bool complete = true;
     for (size_t i = 0; i < tiles.size(); i++)
     {
       TexturePtr& texture = tiles[i].texture;
@@ -218,6 +221,10 @@ namespace tile_map
       {
         bool failed;
         texture = tile_cache_->GetTexture(tiles[i].url_hash, tiles[i].url, failed, priority);
+        if (!texture && !failed)
+        {
+          complete = false;
+        }
       }
 
       if (texture)
@@ -259,21 +266,25 @@ namespace tile_map
         glBindTexture(GL_TEXTURE_2D, 0);
       }
     }
+
+    return complete;
   }
 
-  void TileMapView::Draw()
+  bool TileMapView::Draw()
   {
     if (!tile_source_)
     {
-      return;
+      return true;
     }
 
     glEnable(GL_TEXTURE_2D);
 
-    DrawTiles( precache_, 0 );
-    DrawTiles( tiles_, 10000 );
+    bool complete = DrawTiles( precache_, 0 );
+    complete = DrawTiles( tiles_, 10000 ) && complete;
 
     glDisable(GL_TEXTURE_2D);
+
+    return complete;
   }
 
   void TileMapView::ToLatLon(int32_t level, double x, double y, double& latitude, double& longitude)